@@ -0,0 +1,237 @@
+#ifndef Z_GROUP_H
+#define Z_GROUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Control bytes for open addressing tables probed a group at a time. A full
+// slot holds the low 7 bits of its hash, the other states have the high bit
+// set. The first Z_GROUP_WIDTH bytes are mirrored after the last slot so a
+// group can be loaded from any position.
+
+#define Z_GROUP_WIDTH 16
+#define Z_CTRL_EMPTY ((uint8_t)0x80)
+#define Z_CTRL_DELETED ((uint8_t)0xFE)
+
+typedef uint32_t Z_Group_Mask;
+
+// the control bytes rely on every bit of the hash, so weak hashes are mixed
+// before use
+static inline size_t z__group_mix(size_t hash)
+{
+    hash *= 0x9e3779b97f4a7c15;
+    return hash ^ (hash >> 32);
+}
+
+static inline size_t z__group_h1(size_t hash)
+{
+    return hash >> 7;
+}
+
+static inline uint8_t z__group_h2(size_t hash)
+{
+    return (uint8_t)(hash & 0x7F);
+}
+
+static inline Z_Group_Mask z__group_match(const uint8_t *ctrl, uint8_t h2)
+{
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const void *)ctrl);
+    return (Z_Group_Mask)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#else
+    Z_Group_Mask mask = 0;
+
+    for (size_t i = 0; i < Z_GROUP_WIDTH; i++) {
+        mask |= (Z_Group_Mask)(ctrl[i] == h2) << i;
+    }
+
+    return mask;
+#endif
+}
+
+static inline Z_Group_Mask z__group_match_empty(const uint8_t *ctrl)
+{
+    return z__group_match(ctrl, Z_CTRL_EMPTY);
+}
+
+static inline Z_Group_Mask z__group_match_empty_or_deleted(const uint8_t *ctrl)
+{
+#if defined(__SSE2__)
+    return (Z_Group_Mask)_mm_movemask_epi8(_mm_loadu_si128((const void *)ctrl));
+#else
+    Z_Group_Mask mask = 0;
+
+    for (size_t i = 0; i < Z_GROUP_WIDTH; i++) {
+        mask |= (Z_Group_Mask)(ctrl[i] >> 7) << i;
+    }
+
+    return mask;
+#endif
+}
+
+static inline Z_Group_Mask z__group_match_full(const uint8_t *ctrl)
+{
+    return ~z__group_match_empty_or_deleted(ctrl) & 0xFFFF;
+}
+
+static inline size_t z__group_mask_next(Z_Group_Mask *mask)
+{
+    size_t bit = (size_t)__builtin_ctz(*mask);
+    *mask &= *mask - 1;
+    return bit;
+}
+
+static inline void z__ctrl_set(uint8_t *ctrl, size_t capacity, size_t i, uint8_t value)
+{
+    ctrl[i] = value;
+
+    if (i < Z_GROUP_WIDTH) {
+        ctrl[capacity + i] = value;
+    }
+}
+
+static inline bool z__ctrl_is_full(uint8_t value)
+{
+    return (value & 0x80) == 0;
+}
+
+// Frees slot i and reports whether it could go back to EMPTY. That is safe
+// when every group a probe might have loaded over i also holds an empty
+// slot, no lookup ever continued past it, otherwise it has to stay DELETED.
+static inline bool z__ctrl_erase(uint8_t *ctrl, size_t capacity, size_t i)
+{
+    size_t before = (i - Z_GROUP_WIDTH) & (capacity - 1);
+    Z_Group_Mask empty_after = z__group_match_empty(ctrl + i);
+    Z_Group_Mask empty_before = z__group_match_empty(ctrl + before);
+
+    bool can_be_empty = empty_after && empty_before
+        && (size_t)__builtin_ctz(empty_after) + (size_t)(__builtin_clz(empty_before) - 16) < Z_GROUP_WIDTH;
+
+    z__ctrl_set(ctrl, capacity, i, can_be_empty ? Z_CTRL_EMPTY : Z_CTRL_DELETED);
+    return can_be_empty;
+}
+
+// Turns DELETED into EMPTY and FULL into DELETED, the first step of
+// rehashing a table in place.
+static inline void z__ctrl_prepare_rehash(uint8_t *ctrl, size_t capacity)
+{
+    for (size_t i = 0; i < capacity; i++) {
+        ctrl[i] = z__ctrl_is_full(ctrl[i]) ? Z_CTRL_DELETED : Z_CTRL_EMPTY;
+    }
+
+    memcpy(ctrl + capacity, ctrl, Z_GROUP_WIDTH);
+}
+
+// Triangular probing over groups, which visits every group of a power of
+// two capacity once. pos is the first slot of the group to load next.
+typedef struct {
+    size_t pos;
+    size_t step;
+    size_t mask;
+} Z_Group_Probe;
+
+static inline Z_Group_Probe z__group_probe(size_t hash, size_t capacity)
+{
+    Z_Group_Probe probe = {
+        .pos = z__group_h1(hash) & (capacity - 1),
+        .step = Z_GROUP_WIDTH,
+        .mask = capacity - 1,
+    };
+
+    return probe;
+}
+
+static inline void z__group_probe_next(Z_Group_Probe *probe)
+{
+    probe->pos = (probe->pos + probe->step) & probe->mask;
+    probe->step += Z_GROUP_WIDTH;
+}
+
+// slot of bit i of a mask loaded at the current position
+static inline size_t z__group_probe_slot(const Z_Group_Probe *probe, size_t i)
+{
+    return (probe->pos + i) & probe->mask;
+}
+
+// First empty or deleted slot on the probe sequence of hash.
+static inline size_t z__group_find_insert_slot(const uint8_t *ctrl, size_t capacity, size_t hash)
+{
+    for (Z_Group_Probe probe = z__group_probe(hash, capacity);; z__group_probe_next(&probe)) {
+        Z_Group_Mask match = z__group_match_empty_or_deleted(ctrl + probe.pos);
+
+        if (match) {
+            return z__group_probe_slot(&probe, z__group_mask_next(&match));
+        }
+    }
+}
+
+// Whether slots a and b fall in the same group of the probe sequence that
+// starts at start.
+static inline bool z__group_same_probe(size_t a, size_t b, size_t start, size_t capacity)
+{
+    size_t mask = capacity - 1;
+    return ((a - start) & mask) / Z_GROUP_WIDTH == ((b - start) & mask) / Z_GROUP_WIDTH;
+}
+
+// Number of groups a lookup loads before reaching slot i, counting the home
+// group of hash as the first.
+static inline size_t z__group_probe_length(size_t i, size_t hash, size_t capacity)
+{
+    Z_Group_Probe probe = z__group_probe(hash, capacity);
+    size_t length = 1;
+
+    while (((i - probe.pos) & probe.mask) >= Z_GROUP_WIDTH) {
+        z__group_probe_next(&probe);
+        length++;
+    }
+
+    return length;
+}
+
+// What z__group_rehash_in_place needs to know of the slots of a table: the
+// hash of the element in slot i, and how to exchange the contents of two
+// slots, one of which may be free.
+typedef size_t (*Z_Group_Slot_Hash_Fn)(const void *table, size_t i);
+typedef void (*Z_Group_Slot_Swap_Fn)(void *table, size_t a, size_t b);
+
+// Rehashes a table at its current capacity, dropping every deleted slot.
+// Elements still waiting to be placed are marked DELETED. One that lands in
+// a slot held by another waiting element trades places with it, and the
+// element it got back is placed next. Callers reset occupied to size after.
+static inline void z__group_rehash_in_place(uint8_t *ctrl, size_t capacity, void *table, Z_Group_Slot_Hash_Fn hash_slot, Z_Group_Slot_Swap_Fn swap_slots)
+{
+    z__ctrl_prepare_rehash(ctrl, capacity);
+
+    for (size_t i = 0; i < capacity; i++) {
+        if (ctrl[i] != Z_CTRL_DELETED) {
+            continue;
+        }
+
+        size_t hash = hash_slot(table, i);
+        size_t start = z__group_h1(hash) & (capacity - 1);
+        size_t target = z__group_find_insert_slot(ctrl, capacity, hash);
+
+        if (z__group_same_probe(i, target, start, capacity)) {
+            z__ctrl_set(ctrl, capacity, i, z__group_h2(hash));
+            continue;
+        }
+
+        bool target_was_empty = ctrl[target] == Z_CTRL_EMPTY;
+        z__ctrl_set(ctrl, capacity, target, z__group_h2(hash));
+        swap_slots(table, i, target);
+
+        if (target_was_empty) {
+            z__ctrl_set(ctrl, capacity, i, Z_CTRL_EMPTY);
+        } else {
+            i--;
+        }
+    }
+}
+
+#endif
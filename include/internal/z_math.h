@@ -21,6 +21,16 @@ static inline size_t z__min_size_t(size_t a, size_t b)
     return a < b ? a : b;
 }
 
+static inline size_t z__align_up_size_t(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline size_t z__log2_size_t(size_t value)
+{
+    return (sizeof(unsigned long long) * 8 - 1) - (size_t)__builtin_clzll(value);
+}
+
 static inline float z__max_float(float a, float b)
 {
     return a > b ? a : b;
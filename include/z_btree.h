@@ -0,0 +1,62 @@
+#ifndef Z_BTREE_H
+#define Z_BTREE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <z_compare.h>
+#include <z_hash_table.h>
+#include <z_heap.h>
+
+#define Z_BTREE_ORDER 8
+#define Z_BTREE_MAX_KEYS (2 * Z_BTREE_ORDER - 1)
+#define Z_BTREE_MIN_KEYS (Z_BTREE_ORDER - 1)
+#define Z_BTREE_MAX_HEIGHT 24
+
+typedef struct Z_BTree_Node Z_BTree_Node;
+
+// Ordered map of void * keys, compare is called with two keys and orders
+// them like strcmp. Nodes hold up to Z_BTREE_MAX_KEYS keys in one array,
+// 120 bytes or two cache lines, with the values and children kept apart so
+// a search within a node only touches the keys. Every node but the root is
+// at least half full and all leaves are at the same depth.
+typedef struct {
+    Z_BTree_Node *root;
+    size_t size;
+    Z_Compare_Fn compare;
+    Z_Heap *heap;
+} Z_BTree;
+
+// Path from the root to the next pair, indices[i] is the next key to visit
+// in nodes[i]. Iterators are invalidated by put and delete.
+typedef struct {
+    Z_BTree_Node *nodes[Z_BTREE_MAX_HEIGHT];
+    uint8_t indices[Z_BTREE_MAX_HEIGHT];
+    size_t depth;
+} Z_BTree_Iter;
+
+Z_BTree z_btree_new(Z_Heap *heap, Z_Compare_Fn compare);
+
+// Builds a tree bottom up from pairs sorted by strictly increasing key, in
+// linear time and with every node packed as full as the invariants allow.
+Z_BTree z_btree_from_sorted(Z_Heap *heap, Z_Compare_Fn compare, const Z_Pair *pairs, size_t count);
+
+void *z_btree_get(const Z_BTree *tree, const void *key);
+void *z_btree_try_get(const Z_BTree *tree, const void *key, void *fallback);
+bool z_btree_put(Z_BTree *tree, void *key, void *value, Z_Pair *pair);
+bool z_btree_delete(Z_BTree *tree, const void *key, Z_Pair *pair);
+bool z_btree_contains(const Z_BTree *tree, const void *key);
+bool z_btree_min(const Z_BTree *tree, Z_Pair *pair);
+bool z_btree_max(const Z_BTree *tree, Z_Pair *pair);
+void z_btree_clear(Z_BTree *tree);
+size_t z_btree_size(const Z_BTree *tree);
+
+// Iterators walk the pairs in increasing key order, starting from the
+// smallest key, the first key not less than key or the first key greater
+// than key. A range scan runs from a lower bound until the caller sees a key
+// past its end.
+Z_BTree_Iter z_btree_iter(const Z_BTree *tree);
+Z_BTree_Iter z_btree_lower_bound(const Z_BTree *tree, const void *key);
+Z_BTree_Iter z_btree_upper_bound(const Z_BTree *tree, const void *key);
+bool z_btree_iter_next(Z_BTree_Iter *iter, Z_Pair *pair);
+
+#endif
@@ -4,6 +4,7 @@
 #include <z_heap.h>
 #include <z_array.h>
 #include <z_string.h>
+#include <z_set.h>
 
 typedef enum {
     Z_GET_OPT_BOOL,
@@ -0,0 +1,48 @@
+#ifndef Z_DICT_H
+#define Z_DICT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <z_hash_table.h>
+#include <z_heap.h>
+
+// Insertion ordered hash table. Pairs live densely in entries in the order
+// they were first put, the hashed part only holds a control byte and a 32
+// bit entry index per slot. Iterating, copying and converting to an array
+// touch the live pairs only. Deleting leaves a hole in entries, holes are
+// squeezed out the next time the index is rebuilt.
+typedef struct {
+    uint8_t *ctrl;
+    uint32_t *indices;
+    Z_Pair *entries;
+    size_t entries_length;
+    size_t entries_capacity;
+    size_t occupied;
+    size_t size;
+    size_t capacity;
+    Z_Equal_Fn equal;
+    Z_Hash_Fn hash;
+    Z_Heap *heap;
+} Z_Dict;
+
+typedef struct {
+    const Z_Dict *dict;
+    size_t i;
+} Z_Dict_Iter;
+
+Z_Dict z_dict_new(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash);
+Z_Dict z_dict_new_with_capacity(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity);
+Z_Dict z_dict_clone(Z_Heap *heap, const Z_Dict *dict);
+void *z_dict_get(const Z_Dict *dict, const void *key);
+void *z_dict_try_get(const Z_Dict *dict, const void *key, void *fallback);
+bool z_dict_put(Z_Dict *dict, void *key, void *value, Z_Pair *pair);
+bool z_dict_delete(Z_Dict *dict, const void *key, Z_Pair *pair);
+bool z_dict_contains(const Z_Dict *dict, const void *key);
+size_t z_dict_size(const Z_Dict *dict);
+void z_dict_clear(Z_Dict *dict);
+Z_Pair_Array z_dict_to_array(Z_Heap *heap, const Z_Dict *dict);
+
+Z_Dict_Iter z_dict_iter(const Z_Dict *dict);
+bool z_dict_iter_next(Z_Dict_Iter *iter, Z_Pair *pair);
+
+#endif
@@ -4,6 +4,6 @@
 #include <stdarg.h>
 
 void z_perror_format(const char *format, ...);
-void z_die(const char *format, ...);
+__attribute__((noreturn)) void z_die(const char *format, ...);
 
 #endif
\ No newline at end of file
@@ -2,15 +2,18 @@
 #define Z_HASH_TABLE
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <z_compare.h>
 #include <z_array.h>
 #include <z_heap.h>
+#include <internal/z_group.h>
+#include <internal/z_math.h>
 
 #define Z_HASH_TABLE_MIN_CAPACITY 16
-#define Z_HASH_TABLE_MAX_LOAD_FACTOR 0.7
-#define Z_HASH_TABLE_EMPTY 0
-#define Z_HASH_TABLE_TOMBSTONE 1
+#define Z_HASH_TABLE_MAX_LOAD_FACTOR 0.875
+#define Z_HASH_TABLE_BATCH_SIZE 16
 
 typedef struct {
     void *key;
@@ -22,10 +25,13 @@ Z_DEFINE_ARRAY(Z_Pair_Array, Z_Pair);
 typedef size_t (*Z_Hash_Fn)(const void *);
 typedef bool (*Z_Equal_Fn)(const void *, const void *);
 
+// Swiss table layout: one control byte per slot holding 7 bits of the hash,
+// probed Z_GROUP_WIDTH slots at a time, so a lookup only dereferences keys
+// whose control byte already matched. capacity is zero or a power of two.
 typedef struct {
+    uint8_t *ctrl;
     void **keys;
     void **values;
-    size_t *hashes;
     size_t occupied;
     size_t size;
     size_t capacity;
@@ -39,21 +45,374 @@ typedef struct {
     size_t i;
 } Z_Hash_Table_Iter;
 
+#define Z_HASH_TABLE_PROBE_HISTOGRAM_SIZE 8
+
+// Probe lengths count the groups of control bytes a lookup loads, one means
+// the key sits in its home group. histogram[i] is the number of keys found
+// after i + 1 groups, the last bucket also takes every longer probe.
+// mean_miss averages a lookup for a missing key over every home position.
+typedef struct {
+    size_t max;
+    double mean;
+    double mean_miss;
+    size_t histogram[Z_HASH_TABLE_PROBE_HISTOGRAM_SIZE];
+} Z_Hash_Table_Probe_Stats;
+
+#define Z_HASH_TABLE_STRIPE_BITS 6
+#define Z_HASH_TABLE_STRIPE_COUNT (1 << Z_HASH_TABLE_STRIPE_BITS)
+
+typedef struct Z_Hash_Table_Stripe Z_Hash_Table_Stripe;
+
+// Hash table shared between threads, split into independently locked
+// stripes each owning a private heap. A key always lives in the stripe
+// picked by its hash and stripes grow one at a time, so a resize only
+// blocks the keys of its own stripe. Keys and values are not copied,
+// keeping them alive is up to the caller. Creating one aborts through
+// z_die() when its stripes can't be allocated.
+typedef struct {
+    Z_Hash_Table_Stripe *stripes;
+    Z_Equal_Fn equal;
+    Z_Hash_Fn hash;
+} Z_Concurrent_Hash_Table;
+
 Z_Pair z_make_pair(void *key, void *value);
 Z_Hash_Table z_hash_table_new(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash);
 Z_Hash_Table z_hash_table_new_with_capacity(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity);
 void *z_hash_table_get(const Z_Hash_Table *table, const void *key);
 void *z_hash_table_try_get(const Z_Hash_Table *table, const void *key, void *fallback);
 bool z_hash_table_put(Z_Hash_Table *table, void *key, void *value, Z_Pair *pair);
+void z_hash_table_reserve(Z_Hash_Table *table, size_t size);
 bool z_hash_table_delete(Z_Hash_Table *table, void *key, Z_Pair *pair);
 bool z_hash_table_contains(const Z_Hash_Table *table, void *key);
+void z_hash_table_clear(Z_Hash_Table *table);
+void z_hash_table_shrink_to_fit(Z_Hash_Table *table);
 size_t z_hash_table_size(const Z_Hash_Table *table);
+
+// Batched lookups and inserts hash Z_HASH_TABLE_BATCH_SIZE keys and prefetch
+// their slots before probing any of them. get_batch stores NULL for missing
+// keys and returns how many were found, put_batch reserves room for every
+// key up front.
+size_t z_hash_table_get_batch(const Z_Hash_Table *table, void *const *keys, size_t count, void **values);
+void z_hash_table_put_batch(Z_Hash_Table *table, void *const *keys, void *const *values, size_t count);
 Z_Pair_Array z_hash_table_to_array(Z_Heap *heap, const Z_Hash_Table *table);
 
 Z_Hash_Table_Iter z_hash_table_iter(const Z_Hash_Table *ht);
 bool z_hash_table_iter_next(Z_Hash_Table_Iter *iter, Z_Pair *pair);
 
+Z_Concurrent_Hash_Table z_concurrent_hash_table_new(Z_Equal_Fn equal, Z_Hash_Fn hash);
+void z_concurrent_hash_table_free(Z_Concurrent_Hash_Table *table);
+void *z_concurrent_hash_table_get(const Z_Concurrent_Hash_Table *table, const void *key);
+void *z_concurrent_hash_table_try_get(const Z_Concurrent_Hash_Table *table, const void *key, void *fallback);
+bool z_concurrent_hash_table_put(Z_Concurrent_Hash_Table *table, void *key, void *value, Z_Pair *pair);
+bool z_concurrent_hash_table_delete(Z_Concurrent_Hash_Table *table, void *key, Z_Pair *pair);
+bool z_concurrent_hash_table_contains(const Z_Concurrent_Hash_Table *table, void *key);
+size_t z_concurrent_hash_table_size(const Z_Concurrent_Hash_Table *table);
+
+Z_Hash_Table_Probe_Stats z_hash_table_probe_stats(const Z_Hash_Table *table);
+Z_Hash_Table_Probe_Stats z_concurrent_hash_table_probe_stats(const Z_Concurrent_Hash_Table *table);
+void z_hash_table_dump_probe_stats(Z_Hash_Table_Probe_Stats stats, FILE *fp);
+
 bool z_str_equal(const void *a, const void *b);
 size_t z_str_hash(const void *s);
 
+// z_hash_bytes, z_str_hash and z_sv_hash use a process wide seed, set it to
+// a random value before filling any table to resist hash flooding.
+void z_hash_set_seed(uint64_t seed);
+uint64_t z_hash_get_seed(void);
+size_t z_hash_bytes(const void *data, size_t length);
+uint64_t z_hash_bytes_seeded(const void *data, size_t length, uint64_t seed);
+
+size_t z__hash_table_capacity_for(size_t size);
+void z__probe_stats_add(Z_Hash_Table_Probe_Stats *stats, size_t length);
+void z__probe_stats_add_misses(Z_Hash_Table_Probe_Stats *stats, const uint8_t *ctrl, size_t capacity);
+void z__probe_stats_finish(Z_Hash_Table_Probe_Stats *stats, size_t size, size_t capacity);
+
+#define z_hash_scalar(key) ((size_t)(key))
+#define z_equal_scalar(a, b) ((a) == (b))
+
+// Generates a hash table with keys and values stored inline, hash_fn and
+// equal_fn are called directly so they can be inlined. They may be functions
+// or function like macros taking one key (hash_fn) or two keys (equal_fn) by
+// value, for scalar keys z_hash_scalar and z_equal_scalar will do. Every
+// function is named prefix_*, get returns a pointer to the value inside the
+// table which stays valid until the next put.
+//
+//     Z_DEFINE_HASH_TABLE(Int_Map, int_map, int, int, z_hash_scalar, z_equal_scalar);
+//
+//     Int_Map map = int_map_new(&heap);
+//     int_map_put(&map, 1, 2, NULL);
+//     int *value = int_map_get(&map, 1);
+#define Z_DEFINE_HASH_TABLE(identifier, prefix, key_type, value_type, hash_fn, equal_fn)                         \
+typedef struct {                                                                                                 \
+    key_type key;                                                                                                \
+    value_type value;                                                                                            \
+} identifier##_Slot;                                                                                             \
+                                                                                                                 \
+typedef struct {                                                                                                 \
+    Z_Heap *heap;                                                                                                \
+    uint8_t *ctrl;                                                                                               \
+    identifier##_Slot *slots;                                                                                    \
+    size_t occupied;                                                                                             \
+    size_t size;                                                                                                 \
+    size_t capacity;                                                                                             \
+} identifier;                                                                                                    \
+                                                                                                                 \
+typedef struct {                                                                                                 \
+    const identifier *table;                                                                                     \
+    size_t i;                                                                                                    \
+} identifier##_Iter;                                                                                             \
+                                                                                                                 \
+static inline identifier prefix##__new_exact(Z_Heap *heap, size_t capacity)                                      \
+{                                                                                                                \
+    identifier table = {                                                                                         \
+        .heap = heap,                                                                                            \
+        .ctrl = NULL,                                                                                            \
+        .slots = NULL,                                                                                           \
+        .occupied = 0,                                                                                           \
+        .size = 0,                                                                                               \
+        .capacity = capacity,                                                                                    \
+    };                                                                                                           \
+                                                                                                                 \
+    if (capacity > 0) {                                                                                          \
+        table.ctrl = z_heap_malloc(heap, capacity + Z_GROUP_WIDTH);                                              \
+        table.slots = z_heap_malloc(heap, sizeof(identifier##_Slot) * capacity);                                 \
+        memset(table.ctrl, Z_CTRL_EMPTY, capacity + Z_GROUP_WIDTH);                                              \
+    }                                                                                                            \
+                                                                                                                 \
+    return table;                                                                                                \
+}                                                                                                                \
+                                                                                                                 \
+static inline identifier prefix##_new(Z_Heap *heap)                                                              \
+{                                                                                                                \
+    return prefix##__new_exact(heap, 0);                                                                         \
+}                                                                                                                \
+                                                                                                                 \
+static inline identifier prefix##_new_with_capacity(Z_Heap *heap, size_t capacity)                               \
+{                                                                                                                \
+    return prefix##__new_exact(heap, z__hash_table_capacity_for(capacity));                                      \
+}                                                                                                                \
+                                                                                                                 \
+static inline size_t prefix##__find(const identifier *table, key_type key, size_t hash)                          \
+{                                                                                                                \
+    if (table->capacity == 0) {                                                                                  \
+        return SIZE_MAX;                                                                                         \
+    }                                                                                                            \
+                                                                                                                 \
+    uint8_t h2 = z__group_h2(hash);                                                                              \
+                                                                                                                 \
+    for (Z_Group_Probe probe = z__group_probe(hash, table->capacity);; z__group_probe_next(&probe)) {            \
+        Z_Group_Mask match = z__group_match(table->ctrl + probe.pos, h2);                                        \
+                                                                                                                 \
+        while (match) {                                                                                          \
+            size_t i = z__group_probe_slot(&probe, z__group_mask_next(&match));                                  \
+                                                                                                                 \
+            if (equal_fn(table->slots[i].key, key)) {                                                            \
+                return i;                                                                                        \
+            }                                                                                                    \
+        }                                                                                                        \
+                                                                                                                 \
+        if (z__group_match_empty(table->ctrl + probe.pos)) {                                                     \
+            return SIZE_MAX;                                                                                     \
+        }                                                                                                        \
+    }                                                                                                            \
+}                                                                                                                \
+                                                                                                                 \
+static inline void prefix##__insert_at(identifier *table, size_t i, key_type key, value_type value, size_t hash) \
+{                                                                                                                \
+    if (table->ctrl[i] == Z_CTRL_EMPTY) {                                                                        \
+        table->occupied++;                                                                                       \
+    }                                                                                                            \
+                                                                                                                 \
+    z__ctrl_set(table->ctrl, table->capacity, i, z__group_h2(hash));                                             \
+    table->slots[i].key = key;                                                                                   \
+    table->slots[i].value = value;                                                                               \
+    table->size++;                                                                                               \
+}                                                                                                                \
+                                                                                                                 \
+static inline void prefix##__resize(identifier *table, size_t new_capacity)                                      \
+{                                                                                                                \
+    identifier new_table = prefix##__new_exact(table->heap, new_capacity);                                       \
+                                                                                                                 \
+    for (size_t i = 0; i < table->capacity; i++) {                                                               \
+        if (z__ctrl_is_full(table->ctrl[i])) {                                                                   \
+            size_t hash = z__group_mix(hash_fn(table->slots[i].key));                                            \
+            size_t slot = z__group_find_insert_slot(new_table.ctrl, new_table.capacity, hash);                   \
+            prefix##__insert_at(&new_table, slot, table->slots[i].key, table->slots[i].value, hash);             \
+        }                                                                                                        \
+    }                                                                                                            \
+                                                                                                                 \
+    if (table->capacity > 0) {                                                                                   \
+        z_heap_free(table->heap, table->ctrl);                                                                   \
+        z_heap_free(table->heap, table->slots);                                                                  \
+    }                                                                                                            \
+                                                                                                                 \
+    *table = new_table;                                                                                          \
+}                                                                                                                \
+                                                                                                                 \
+static inline size_t prefix##__slot_hash(const void *table, size_t i)                                            \
+{                                                                                                                \
+    const identifier *t = table;                                                                                 \
+    return z__group_mix(hash_fn(t->slots[i].key));                                                               \
+}                                                                                                                \
+                                                                                                                 \
+static inline void prefix##__swap_slots(void *table, size_t a, size_t b)                                         \
+{                                                                                                                \
+    identifier *t = table;                                                                                       \
+    identifier##_Slot slot = t->slots[a];                                                                        \
+    t->slots[a] = t->slots[b];                                                                                   \
+    t->slots[b] = slot;                                                                                          \
+}                                                                                                                \
+                                                                                                                 \
+static inline void prefix##__rehash_in_place(identifier *table)                                                  \
+{                                                                                                                \
+    z__group_rehash_in_place(table->ctrl, table->capacity, table, prefix##__slot_hash, prefix##__swap_slots);    \
+    table->occupied = table->size;                                                                               \
+}                                                                                                                \
+                                                                                                                 \
+static inline void prefix##__make_room(identifier *table)                                                        \
+{                                                                                                                \
+    if (table->capacity > 0 && table->size * 16 <= table->capacity * 7) {                                        \
+        prefix##__rehash_in_place(table);                                                                        \
+    } else {                                                                                                     \
+        prefix##__resize(table, z__max_size_t(Z_HASH_TABLE_MIN_CAPACITY, table->capacity * 2));                  \
+    }                                                                                                            \
+}                                                                                                                \
+                                                                                                                 \
+static inline value_type *prefix##_get(const identifier *table, key_type key)                                    \
+{                                                                                                                \
+    size_t i = prefix##__find(table, key, z__group_mix(hash_fn(key)));                                           \
+                                                                                                                 \
+    if (i == SIZE_MAX) {                                                                                         \
+        return NULL;                                                                                             \
+    }                                                                                                            \
+                                                                                                                 \
+    return &table->slots[i].value;                                                                               \
+}                                                                                                                \
+                                                                                                                 \
+static inline value_type prefix##_try_get(const identifier *table, key_type key, value_type fallback)            \
+{                                                                                                                \
+    value_type *value = prefix##_get(table, key);                                                                \
+    return value ? *value : fallback;                                                                            \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool prefix##_contains(const identifier *table, key_type key)                                      \
+{                                                                                                                \
+    return prefix##__find(table, key, z__group_mix(hash_fn(key))) != SIZE_MAX;                                   \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool prefix##_put(identifier *table, key_type key, value_type value, value_type *old_value)        \
+{                                                                                                                \
+    if (table->occupied * 8 >= table->capacity * 7) {                                                            \
+        prefix##__make_room(table);                                                                              \
+    }                                                                                                            \
+                                                                                                                 \
+    size_t hash = z__group_mix(hash_fn(key));                                                                    \
+    size_t i = prefix##__find(table, key, hash);                                                                 \
+                                                                                                                 \
+    if (i != SIZE_MAX) {                                                                                         \
+        if (old_value) {                                                                                         \
+            *old_value = table->slots[i].value;                                                                  \
+        }                                                                                                        \
+                                                                                                                 \
+        table->slots[i].key = key;                                                                               \
+        table->slots[i].value = value;                                                                           \
+        return true;                                                                                             \
+    }                                                                                                            \
+                                                                                                                 \
+    prefix##__insert_at(table, z__group_find_insert_slot(table->ctrl, table->capacity, hash), key, value, hash); \
+    return false;                                                                                                \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool prefix##_delete(identifier *table, key_type key, value_type *value)                           \
+{                                                                                                                \
+    size_t i = prefix##__find(table, key, z__group_mix(hash_fn(key)));                                           \
+                                                                                                                 \
+    if (i == SIZE_MAX) {                                                                                         \
+        return false;                                                                                            \
+    }                                                                                                            \
+                                                                                                                 \
+    if (value) {                                                                                                 \
+        *value = table->slots[i].value;                                                                          \
+    }                                                                                                            \
+                                                                                                                 \
+    if (z__ctrl_erase(table->ctrl, table->capacity, i)) {                                                        \
+        table->occupied--;                                                                                       \
+    }                                                                                                            \
+                                                                                                                 \
+    table->size--;                                                                                               \
+    return true;                                                                                                 \
+}                                                                                                                \
+                                                                                                                 \
+static inline void prefix##_clear(identifier *table)                                                             \
+{                                                                                                                \
+    if (table->capacity > 0) {                                                                                   \
+        memset(table->ctrl, Z_CTRL_EMPTY, table->capacity + Z_GROUP_WIDTH);                                      \
+    }                                                                                                            \
+                                                                                                                 \
+    table->occupied = 0;                                                                                         \
+    table->size = 0;                                                                                             \
+}                                                                                                                \
+                                                                                                                 \
+static inline void prefix##_shrink_to_fit(identifier *table)                                                     \
+{                                                                                                                \
+    size_t new_capacity = z__hash_table_capacity_for(table->size);                                               \
+                                                                                                                 \
+    if (new_capacity < table->capacity) {                                                                        \
+        prefix##__resize(table, new_capacity);                                                                   \
+    } else if (table->occupied > table->size) {                                                                  \
+        prefix##__rehash_in_place(table);                                                                        \
+    }                                                                                                            \
+}                                                                                                                \
+                                                                                                                 \
+static inline Z_Hash_Table_Probe_Stats prefix##_probe_stats(const identifier *table)                             \
+{                                                                                                                \
+    Z_Hash_Table_Probe_Stats stats = {0};                                                                        \
+                                                                                                                 \
+    for (size_t i = 0; i < table->capacity; i++) {                                                               \
+        if (z__ctrl_is_full(table->ctrl[i])) {                                                                   \
+            size_t hash = z__group_mix(hash_fn(table->slots[i].key));                                            \
+            z__probe_stats_add(&stats, z__group_probe_length(i, hash, table->capacity));                         \
+        }                                                                                                        \
+    }                                                                                                            \
+                                                                                                                 \
+    z__probe_stats_add_misses(&stats, table->ctrl, table->capacity);                                             \
+    z__probe_stats_finish(&stats, table->size, table->capacity);                                                 \
+                                                                                                                 \
+    return stats;                                                                                                \
+}                                                                                                                \
+                                                                                                                 \
+static inline size_t prefix##_size(const identifier *table)                                                      \
+{                                                                                                                \
+    return table->size;                                                                                          \
+}                                                                                                                \
+                                                                                                                 \
+static inline identifier##_Iter prefix##_iter(const identifier *table)                                           \
+{                                                                                                                \
+    identifier##_Iter iter = {                                                                                   \
+        .table = table,                                                                                          \
+        .i = 0,                                                                                                  \
+    };                                                                                                           \
+                                                                                                                 \
+    return iter;                                                                                                 \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool prefix##_iter_next(identifier##_Iter *iter, key_type *key, value_type *value)                 \
+{                                                                                                                \
+    const identifier *table = iter->table;                                                                       \
+                                                                                                                 \
+    while (iter->i < table->capacity) {                                                                          \
+        size_t i = iter->i++;                                                                                    \
+                                                                                                                 \
+        if (z__ctrl_is_full(table->ctrl[i])) {                                                                   \
+            *key = table->slots[i].key;                                                                          \
+            *value = table->slots[i].value;                                                                      \
+            return true;                                                                                         \
+        }                                                                                                        \
+    }                                                                                                            \
+                                                                                                                 \
+    return false;                                                                                                \
+}                                                                                                                \
+                                                                                                                 \
+_Static_assert(sizeof(key_type) > 0, "key type must be complete")
+
 #endif
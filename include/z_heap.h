@@ -1,8 +1,10 @@
 #ifndef HEAP_H
 #define HEAP_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 
 typedef struct {
     uintptr_t *ptr;
@@ -10,12 +12,132 @@ typedef struct {
     size_t capacity;
 } Z_Ptr_Table;
 
-typedef Z_Ptr_Table Z_Heap;
+#define Z_POOL_CLASS_COUNT 14
+#define Z_POOL_MAX_SIZE 2048
+#define Z_POOL_SLAB_SIZE (64 * 1024)
+#define Z_HEAP_SHARD_COUNT 64
+#define Z_HEAP_LARGE_THRESHOLD (1024 * 1024)
+
+typedef enum {
+    Z_HEAP_MALLOC,
+    Z_HEAP_ARENA,
+    Z_HEAP_POOL,
+    Z_HEAP_CONCURRENT,
+} Z_Heap_Kind;
+
+typedef struct Z_Arena_Chunk Z_Arena_Chunk;
+
+// Chunked bump allocator. Freeing is a no-op except for the most recent
+// allocation, which can also be grown or shrunk in place.
+typedef struct {
+    Z_Arena_Chunk *first;
+    Z_Arena_Chunk *current;
+    void *last;
+    size_t chunk_size;
+    Z_Arena_Chunk *mark_chunk;
+    size_t mark_used;
+} Z_Arena;
+
+typedef struct Z_Pool_Slab Z_Pool_Slab;
+typedef struct Z_Pool_Block Z_Pool_Block;
+
+// Size-class allocator. Blocks up to Z_POOL_MAX_SIZE are carved out of
+// Z_POOL_SLAB_SIZE aligned slabs and recycled through per-class free lists,
+// bigger ones fall back to malloc and the pointer table.
+typedef struct {
+    Z_Pool_Block *free_lists[Z_POOL_CLASS_COUNT];
+    Z_Pool_Slab *current[Z_POOL_CLASS_COUNT];
+    Z_Pool_Slab *slabs;
+    Z_Pool_Slab *spare_slabs;
+} Z_Pool;
+
+// Pointer table split into independently locked shards, a pointer always
+// lives in the shard picked by its hash. z_heap_free_all() destroys the
+// shards, so a concurrent heap can't be used after it.
+typedef struct Z_Heap_Shards Z_Heap_Shards;
+
+// Live bytes are what the backend hands out: the requested size for arenas,
+// the size class for pool blocks and malloc_usable_size() for malloc blocks.
+typedef struct {
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t alloc_count;
+    size_t free_count;
+    size_t realloc_count;
+    size_t realloc_copy_bytes;
+} Z_Heap_Stats;
+
+typedef struct Z_Heap_Call_Site Z_Heap_Call_Site;
+
+typedef struct {
+    Z_Heap_Call_Site *ptr;
+    size_t length;
+    size_t capacity;
+} Z_Heap_Call_Sites;
+
+typedef struct {
+    uintptr_t *ptr;
+    size_t length;
+    size_t capacity;
+} Z_Heap_Log;
+
+// A zero initialized heap is a malloc heap, every allocation is a real
+// malloc tracked in the pointer table. Malloc and pool heaps map blocks of
+// Z_HEAP_LARGE_THRESHOLD bytes and more directly with mmap, grow them with
+// mremap and hand them back to the OS on free.
+typedef struct {
+    Z_Heap_Kind kind;
+    Z_Ptr_Table table;
+    Z_Arena arena;
+    Z_Pool pool;
+    Z_Heap_Shards *shards;
+    Z_Ptr_Table large;
+    bool huge_pages;
+    bool track_stats;
+    bool track_call_sites;
+    Z_Heap_Stats stats;
+    Z_Heap_Call_Sites call_sites;
+    size_t mark_depth;
+    Z_Heap_Log log;
+    Z_Ptr_Table young;
+} Z_Heap;
+
+// Position in a heap to rewind to. Marks nest like a stack, rewinding or
+// unmarking one also releases every mark taken after it. Rewinding frees
+// what was allocated after the mark and keeps everything older, including
+// older blocks that realloc moved in the meantime. An arena can't keep
+// those in bump space, so while a mark is active they move to malloc
+// blocks owned by the heap, which live until z_heap_free_all() or
+// z_heap_reset().
+typedef struct {
+    size_t depth;
+    size_t log_length;
+    size_t live_bytes;
+    Z_Arena_Chunk *chunk;
+    size_t chunk_used;
+    Z_Arena_Chunk *previous_chunk;
+    size_t previous_used;
+} Z_Heap_Mark;
 
 typedef void (*Z_Free_Fn)(Z_Heap *, void *);
 
 #define Z_Heap_Auto __attribute__((cleanup(z_heap_free_all))) Z_Heap
 
+Z_Heap z_heap_new(void);
+Z_Heap z_heap_new_arena(size_t chunk_size);
+Z_Heap z_heap_new_pool(void);
+
+// Aborts through z_die() when its shards can't be allocated, the heap is
+// returned by value so there is nothing to hand back instead.
+Z_Heap z_heap_new_concurrent(void);
+
+// Pool heap private to the calling thread, created on first use and freed
+// when the thread exits, or by exit() for the thread calling it. A later
+// call from a thread exit destructor or atexit handler creates a fresh
+// heap, so pointers from the old one must not be used past that point.
+// Returns NULL when the heap can't be allocated.
+Z_Heap *z_heap_thread_local(void);
+
 void *z_heap_malloc(Z_Heap *heap, size_t size);
 void *z_heap_calloc(Z_Heap *heap, size_t size);
 void *z_heap_realloc(Z_Heap *heap, void *ptr, size_t new_size);
@@ -23,4 +145,26 @@ void z_heap_free(Z_Heap *heap, void *ptr);
 void z_heap_free_all(Z_Heap *heap);
 void z_heap_reset(Z_Heap *heap);
 
+Z_Heap_Mark z_heap_mark(Z_Heap *heap);
+void z_heap_rewind(Z_Heap *heap, Z_Heap_Mark mark);
+void z_heap_unmark(Z_Heap *heap, Z_Heap_Mark mark);
+
+void *z_heap_malloc_at(Z_Heap *heap, size_t size, const char *file, int line);
+void *z_heap_calloc_at(Z_Heap *heap, size_t size, const char *file, int line);
+void *z_heap_realloc_at(Z_Heap *heap, void *ptr, size_t new_size, const char *file, int line);
+
+void z_heap_enable_huge_pages(Z_Heap *heap);
+void z_heap_enable_stats(Z_Heap *heap);
+void z_heap_enable_call_sites(Z_Heap *heap);
+Z_Heap_Stats z_heap_get_stats(const Z_Heap *heap);
+void z_heap_dump_stats(const Z_Heap *heap, FILE *fp);
+
+// Build with -DZ_HEAP_TRACE to attribute every allocation to the file and
+// line that made it, including the ones expanded from z_array_* macros.
+#ifdef Z_HEAP_TRACE
+#define z_heap_malloc(heap, size) z_heap_malloc_at(heap, size, __FILE__, __LINE__)
+#define z_heap_calloc(heap, size) z_heap_calloc_at(heap, size, __FILE__, __LINE__)
+#define z_heap_realloc(heap, ptr, new_size) z_heap_realloc_at(heap, ptr, new_size, __FILE__, __LINE__)
+#endif
+
 #endif
@@ -0,0 +1,64 @@
+#ifndef Z_INTERN_H
+#define Z_INTERN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <z_hash_table.h>
+#include <z_heap.h>
+#include <z_set.h>
+#include <z_string.h>
+
+typedef struct Z_Interned Z_Interned;
+
+Z_DEFINE_ARRAY(Z_Interned_Array, Z_Interned *);
+
+// Stores one copy of every distinct string and hands out its canonical
+// pointer, two strings interned in the same interner are equal exactly when
+// their pointers are. Interned strings are nul terminated, never move and
+// carry their length, hash and id in front of them, so tables keyed by them
+// can use z_interned_hash and z_interned_equal instead of z_str_hash and
+// z_str_equal. Ids count up from 0 in interning order. z_intern() returns
+// NULL when the copy of a new string can't be allocated.
+//
+// The lookup table and id array live in heap, the string copies in strings,
+// which can be an arena since interned strings are never freed one by one.
+typedef struct {
+    Z_Set set;
+    Z_Interned_Array entries;
+    Z_Heap *strings;
+} Z_Interner;
+
+#define Z_INTERNER_STRIPE_BITS 6
+#define Z_INTERNER_STRIPE_COUNT (1 << Z_INTERNER_STRIPE_BITS)
+
+typedef struct Z_Interner_Stripe Z_Interner_Stripe;
+
+// Interner shared between threads, split into independently locked stripes
+// each owning a private heap and string arena. The low bits of an id name
+// the stripe the string lives in. Creating one aborts through z_die() when
+// its stripes can't be allocated, z_concurrent_intern() returns NULL like
+// z_intern().
+typedef struct {
+    Z_Interner_Stripe *stripes;
+} Z_Concurrent_Interner;
+
+Z_Interner z_interner_new(Z_Heap *heap, Z_Heap *strings);
+const char *z_intern(Z_Interner *interner, Z_String_View s);
+const char *z_interner_find(const Z_Interner *interner, Z_String_View s);
+const char *z_interner_get(const Z_Interner *interner, uint32_t id);
+size_t z_interner_size(const Z_Interner *interner);
+
+Z_Concurrent_Interner z_concurrent_interner_new(void);
+void z_concurrent_interner_free(Z_Concurrent_Interner *interner);
+const char *z_concurrent_intern(Z_Concurrent_Interner *interner, Z_String_View s);
+const char *z_concurrent_interner_find(const Z_Concurrent_Interner *interner, Z_String_View s);
+const char *z_concurrent_interner_get(const Z_Concurrent_Interner *interner, uint32_t id);
+size_t z_concurrent_interner_size(const Z_Concurrent_Interner *interner);
+
+uint32_t z_interned_id(const char *s);
+size_t z_interned_length(const char *s);
+Z_String_View z_interned_sv(const char *s);
+size_t z_interned_hash(const void *s);
+bool z_interned_equal(const void *a, const void *b);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef Z_MAPPED_TABLE_H
+#define Z_MAPPED_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <z_hash_table.h>
+#include <z_string.h>
+
+// Read only string to string table mapped straight from a file written by
+// z_mapped_table_save(). The file holds the control bytes, a slot array of
+// offsets and the strings themselves, all addressed relative to its start,
+// so opening it is a single mmap and lookups never parse or allocate.
+// Values returned point into the mapping and live until close. Files are
+// trusted, only the header is validated on open.
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    const uint8_t *ctrl;
+    const void *slots;
+    size_t capacity;
+    size_t size;
+    uint64_t seed;
+} Z_Mapped_Table;
+
+#define Z_Mapped_Table_Auto __attribute__((cleanup(z_mapped_table_close))) Z_Mapped_Table
+
+// keys and values of table must be nul terminated strings, they are hashed
+// with the process seed which is recorded in the file for lookups
+bool z_mapped_table_save(const Z_Hash_Table *table, const char *pathname);
+
+bool z_mapped_table_open(Z_Mapped_Table *table, const char *pathname);
+void z_mapped_table_close(Z_Mapped_Table *table);
+const char *z_mapped_table_get(const Z_Mapped_Table *table, const char *key);
+bool z_mapped_table_get_sv(const Z_Mapped_Table *table, Z_String_View key, Z_String_View *value);
+size_t z_mapped_table_size(const Z_Mapped_Table *table);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef Z_MATCHER_H
+#define Z_MATCHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <z_array.h>
+#include <z_heap.h>
+#include <z_string.h>
+
+// pattern is the index of the pattern in the array the matcher was built
+// from, offset is where the match starts
+typedef struct {
+    uint32_t pattern;
+    size_t offset;
+} Z_Match;
+
+Z_DEFINE_ARRAY(Z_Match_Array, Z_Match);
+
+// Aho-Corasick automaton finding every occurrence of a set of patterns in a
+// single pass. The trie is turned into a full transition table over byte
+// classes, bytes that appear in no pattern share one class, so scanning a
+// byte is two loads and no branch on a miss. States that end a pattern are
+// flagged in the table itself. With ignore_case ASCII letters of the
+// patterns and the text share a class. Empty patterns never match.
+typedef struct {
+    uint16_t classes[256];
+    size_t class_count;
+    uint32_t *table;
+    uint32_t *outputs;
+    uint32_t *dict_links;
+    uint32_t *pattern_next;
+    size_t *pattern_lengths;
+    size_t state_count;
+    size_t pattern_count;
+    Z_Heap *heap;
+} Z_Matcher;
+
+// Matching state carried from one chunk of a stream to the next, so matches
+// spanning chunk boundaries are found. Offsets count from the start of the
+// stream.
+typedef struct {
+    const Z_Matcher *matcher;
+    uint32_t row;
+    size_t offset;
+} Z_Matcher_Stream;
+
+Z_Matcher z_matcher_new(Z_Heap *heap, const Z_String_Array *patterns, bool ignore_case);
+
+// Matches are appended in the order they end, overlapping ones included.
+void z_matcher_find_all(const Z_Matcher *matcher, Z_String_View text, Z_Match_Array *out);
+bool z_matcher_find_first(const Z_Matcher *matcher, Z_String_View text, Z_Match *match);
+bool z_matcher_contains(const Z_Matcher *matcher, Z_String_View text);
+
+Z_Matcher_Stream z_matcher_stream(const Z_Matcher *matcher);
+void z_matcher_stream_feed(Z_Matcher_Stream *stream, Z_String_View chunk, Z_Match_Array *out);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef Z_ROPE_H
+#define Z_ROPE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <z_heap.h>
+#include <z_string.h>
+
+#define Z_ROPE_CHUNK_SIZE (16 * 1024)
+
+typedef struct Z_Rope_Node Z_Rope_Node;
+
+// Text kept as a sequence of chunks of up to Z_ROPE_CHUNK_SIZE bytes, for
+// outputs too big to rebuild on every change. The chunks are the nodes of a
+// treap ordered by position, each knowing how many bytes its subtree holds,
+// so inserting anywhere is O(log n) and costs at most one chunk worth of
+// copying. Appends go to a tail chunk outside the tree and are amortized
+// O(1). The bytes are copied in and may hold nul, the rope never keeps a
+// pointer to its input.
+typedef struct {
+    Z_Rope_Node *root;
+    Z_Rope_Node *tail;
+    size_t length;
+    size_t chunk_count;
+    uint64_t seed;
+    Z_Heap *heap;
+} Z_Rope;
+
+Z_Rope z_rope_new(Z_Heap *heap);
+
+void z_rope_append_str(Z_Rope *rope, Z_String_View s);
+void z_rope_append_char(Z_Rope *rope, char c);
+void z_rope_insert(Z_Rope *rope, size_t position, Z_String_View s);
+size_t z_rope_length(const Z_Rope *rope);
+void z_rope_clear(Z_Rope *rope);
+
+// Copies the whole text once into a string allocated from heap.
+Z_String z_rope_to_str(const Z_Rope *rope, Z_Heap *heap);
+
+// Writes the chunks in place with writev, as many per call as the system
+// allows, and retries short writes. Returns false with errno set when a
+// write fails.
+bool z_rope_write(const Z_Rope *rope, int fd);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef Z_SET_H
+#define Z_SET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <z_hash_table.h>
+#include <z_heap.h>
+
+// Hash set of void * keys laid out like Z_Hash_Table minus the values, one
+// control byte and one key pointer per slot. Z_String_View keys are stored
+// as pointers to views with z_sv_ptr_equal and z_sv_ptr_hash.
+//
+// Binary operations build a new set on heap and only iterate the smaller
+// operand, looking its keys up in the bigger one.
+typedef struct {
+    uint8_t *ctrl;
+    void **keys;
+    size_t occupied;
+    size_t size;
+    size_t capacity;
+    Z_Equal_Fn equal;
+    Z_Hash_Fn hash;
+    Z_Heap *heap;
+} Z_Set;
+
+typedef struct {
+    const Z_Set *set;
+    size_t i;
+} Z_Set_Iter;
+
+Z_Set z_set_new(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash);
+Z_Set z_set_new_with_capacity(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity);
+Z_Set z_set_clone(Z_Heap *heap, const Z_Set *set);
+bool z_set_add(Z_Set *set, void *key);
+bool z_set_remove(Z_Set *set, const void *key);
+bool z_set_contains(const Z_Set *set, const void *key);
+void *z_set_get(const Z_Set *set, const void *key);
+size_t z_set_size(const Z_Set *set);
+void z_set_reserve(Z_Set *set, size_t size);
+void z_set_clear(Z_Set *set);
+
+Z_Set z_set_union(Z_Heap *heap, const Z_Set *a, const Z_Set *b);
+Z_Set z_set_intersection(Z_Heap *heap, const Z_Set *a, const Z_Set *b);
+Z_Set z_set_difference(Z_Heap *heap, const Z_Set *a, const Z_Set *b);
+bool z_set_is_subset(const Z_Set *a, const Z_Set *b);
+
+Z_Set_Iter z_set_iter(const Z_Set *set);
+bool z_set_iter_next(Z_Set_Iter *iter, void **key);
+
+#endif
@@ -14,7 +14,7 @@ typedef struct {
 
 Z_DEFINE_ARRAY(Z_String, char);
 Z_DEFINE_ARRAY(Z_String_Array, Z_String);
-Z_DEFINE_ARRAY(Z_String_View_Array, Z_String);
+Z_DEFINE_ARRAY(Z_String_View_Array, Z_String_View);
 
 typedef struct {
     Z_String_View s;
@@ -44,6 +44,7 @@ void z_str_prepend_char(Z_String *s, char c);
 
 char z_str_pop_char(Z_String *s);
 void z_str_replace(Z_String *s, Z_String_View target, Z_String_View replacement);
+void z_str_replace_many(Z_String *s, const Z_String_View *targets, const Z_String_View *replacements, size_t count);
 void z_str_clear(Z_String *s);
 void z_str_set_format(Z_String *s, const char *format, ...);
 void z_str_set_format_va(Z_String *s, const char *format, va_list args);
@@ -51,6 +52,7 @@ void z_str_set_format_va(Z_String *s, const char *format, va_list args);
 Z_Sv_Split_Iter z_sv_split_iter(Z_String_View s, Z_String_View delimeter);
 bool z_sv_split_iter_next(Z_Sv_Split_Iter *iterator, Z_String_View *next);
 Z_String_View z_sv_split_part(Z_String_View s, Z_String_View delimiter, size_t index);
+void z_sv_split(Z_String_View s, Z_String_View delimiter, Z_String_View_Array *out);
 void z_str_split(Z_String_View s, Z_String_View delimiter, Z_String_Array *out);
 
 void z_str_trim(Z_String *s);
@@ -81,11 +83,16 @@ bool z_sv_equal_n(Z_String_View a, Z_String_View b, size_t n);
 bool z_sv_like(Z_String_View a, Z_String_View b);
 bool z_sv_naive_like(Z_String_View str, Z_String_View pattern);
 
+size_t z_sv_hash(Z_String_View s);
+size_t z_sv_ptr_hash(const void *s);
+bool z_sv_ptr_equal(const void *a, const void *b);
+
 bool z_sv_starts_with(Z_String_View s, Z_String_View start);
 bool z_sv_ends_with(Z_String_View s, Z_String_View end);
 bool z_sv_contains(Z_String_View haystack, Z_String_View needle);
 bool z_sv_contain_char(Z_String_View s, char c);
 ssize_t z_sv_find_index(Z_String_View haystack, Z_String_View needle);
+ssize_t z_sv_find_last_index(Z_String_View haystack, Z_String_View needle);
 
 Z_String_View z_sv_trim(Z_String_View s);
 Z_String_View z_sv_trim_cset(Z_String_View s, Z_String_View cset);
@@ -0,0 +1,42 @@
+#ifndef Z_STRING_BUILDER_H
+#define Z_STRING_BUILDER_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <z_heap.h>
+#include <z_string.h>
+
+// A string with spare room on both sides of its text, so prepending is as
+// cheap as appending: amortized O(1) per byte either way. Made for output
+// built back to front, like a frame whose headers are only known after its
+// payload. The text is ptr[start, start + length), always nul terminated
+// and may hold nul bytes. Views of the builder's own text may be passed
+// back to it. Like Z_Rope and Z_BTree, none of the growing calls can report
+// failure, so running out of memory aborts through z_die().
+typedef struct {
+    Z_Heap *heap;
+    char *ptr;
+    size_t start;
+    size_t length;
+    size_t capacity;
+} Z_String_Builder;
+
+Z_String_Builder z_sb_new(Z_Heap *heap);
+Z_String_Builder z_sb_new_with_capacity(Z_Heap *heap, size_t front, size_t back);
+
+void z_sb_prepend_str(Z_String_Builder *sb, Z_String_View s);
+void z_sb_prepend_char(Z_String_Builder *sb, char c);
+void z_sb_prepend_format(Z_String_Builder *sb, const char *format, ...);
+void z_sb_prepend_format_va(Z_String_Builder *sb, const char *format, va_list args);
+
+void z_sb_append_str(Z_String_Builder *sb, Z_String_View s);
+void z_sb_append_char(Z_String_Builder *sb, char c);
+void z_sb_append_format(Z_String_Builder *sb, const char *format, ...);
+void z_sb_append_format_va(Z_String_Builder *sb, const char *format, va_list args);
+
+Z_String_View z_sb_view(const Z_String_Builder *sb);
+size_t z_sb_length(const Z_String_Builder *sb);
+void z_sb_clear(Z_String_Builder *sb);
+Z_String z_sb_to_str(Z_String_Builder *sb);
+
+#endif
@@ -8,4 +8,13 @@
 #include "z_string.c"
 #include "z_time.c"
 #include "z_hash_table.c"
-#include "z_error.c"
\ No newline at end of file
+#include "z_error.c"
+#include "z_set.c"
+#include "z_dict.c"
+#include "z_mapped_table.c"
+#include "z_btree.c"
+#include "z_intern.c"
+#include "z_search.c"
+#include "z_matcher.c"
+#include "z_string_builder.c"
+#include "z_rope.c"
\ No newline at end of file
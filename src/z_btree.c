@@ -0,0 +1,653 @@
+#include <z_btree.h>
+#include <z_error.h>
+#include <stddef.h>
+#include <string.h>
+
+// Leaves are allocated without the children array.
+struct Z_BTree_Node {
+    uint16_t length;
+    bool leaf;
+    void *keys[Z_BTREE_MAX_KEYS];
+    void *values[Z_BTREE_MAX_KEYS];
+    Z_BTree_Node *children[];
+};
+
+Z_BTree_Node *z__btree_new_node(Z_Heap *heap, bool leaf);
+void z__btree_free_node(Z_Heap *heap, Z_BTree_Node *node);
+size_t z__btree_search(const Z_BTree *tree, const Z_BTree_Node *node, const void *key, bool *found);
+size_t z__btree_search_upper(const Z_BTree *tree, const Z_BTree_Node *node, const void *key);
+void z__btree_insert_at(Z_BTree_Node *node, size_t i, void *key, void *value);
+void z__btree_remove_at(Z_BTree_Node *node, size_t i);
+void z__btree_split_child(Z_BTree *tree, Z_BTree_Node *node, size_t i);
+void z__btree_rotate_right(Z_BTree_Node *node, size_t i);
+void z__btree_rotate_left(Z_BTree_Node *node, size_t i);
+void z__btree_merge(Z_BTree *tree, Z_BTree_Node *node, size_t i);
+size_t z__btree_fill_child(Z_BTree *tree, Z_BTree_Node *node, size_t i);
+Z_Pair z__btree_take_max(Z_BTree *tree, Z_BTree_Node *node);
+Z_Pair z__btree_take_min(Z_BTree *tree, Z_BTree_Node *node);
+void z__btree_shrink_root(Z_BTree *tree);
+void z__btree_iter_push_leftmost(Z_BTree_Iter *iter, Z_BTree_Node *node);
+
+Z_BTree z_btree_new(Z_Heap *heap, Z_Compare_Fn compare)
+{
+    Z_BTree tree = {
+        .root = NULL,
+        .size = 0,
+        .compare = compare,
+        .heap = heap,
+    };
+
+    return tree;
+}
+
+Z_BTree_Node *z__btree_new_node(Z_Heap *heap, bool leaf)
+{
+    size_t size = offsetof(Z_BTree_Node, children);
+
+    if (!leaf) {
+        size += sizeof(Z_BTree_Node *) * (Z_BTREE_MAX_KEYS + 1);
+    }
+
+    Z_BTree_Node *node = z_heap_malloc(heap, size);
+
+    if (!node) {
+        z_die("z_btree: out of memory\n");
+    }
+
+    node->length = 0;
+    node->leaf = leaf;
+
+    return node;
+}
+
+void z__btree_free_node(Z_Heap *heap, Z_BTree_Node *node)
+{
+    if (!node->leaf) {
+        for (size_t i = 0; i <= node->length; i++) {
+            z__btree_free_node(heap, node->children[i]);
+        }
+    }
+
+    z_heap_free(heap, node);
+}
+
+// Index of the first key not less than key.
+size_t z__btree_search(const Z_BTree *tree, const Z_BTree_Node *node, const void *key, bool *found)
+{
+    size_t low = 0;
+    size_t high = node->length;
+
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        int order = tree->compare(node->keys[mid], key);
+
+        if (order < 0) {
+            low = mid + 1;
+        } else if (order > 0) {
+            high = mid;
+        } else {
+            *found = true;
+            return mid;
+        }
+    }
+
+    *found = false;
+    return low;
+}
+
+// Index of the first key greater than key.
+size_t z__btree_search_upper(const Z_BTree *tree, const Z_BTree_Node *node, const void *key)
+{
+    size_t low = 0;
+    size_t high = node->length;
+
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+
+        if (tree->compare(node->keys[mid], key) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+void z__btree_insert_at(Z_BTree_Node *node, size_t i, void *key, void *value)
+{
+    size_t tail = node->length - i;
+    memmove(node->keys + i + 1, node->keys + i, sizeof(void *) * tail);
+    memmove(node->values + i + 1, node->values + i, sizeof(void *) * tail);
+    node->keys[i] = key;
+    node->values[i] = value;
+    node->length++;
+}
+
+void z__btree_remove_at(Z_BTree_Node *node, size_t i)
+{
+    size_t tail = node->length - i - 1;
+    memmove(node->keys + i, node->keys + i + 1, sizeof(void *) * tail);
+    memmove(node->values + i, node->values + i + 1, sizeof(void *) * tail);
+    node->length--;
+}
+
+void *z_btree_get(const Z_BTree *tree, const void *key)
+{
+    return z_btree_try_get(tree, key, NULL);
+}
+
+void *z_btree_try_get(const Z_BTree *tree, const void *key, void *fallback)
+{
+    const Z_BTree_Node *node = tree->root;
+
+    while (node) {
+        bool found;
+        size_t i = z__btree_search(tree, node, key, &found);
+
+        if (found) {
+            return node->values[i];
+        }
+
+        node = node->leaf ? NULL : node->children[i];
+    }
+
+    return fallback;
+}
+
+bool z_btree_contains(const Z_BTree *tree, const void *key)
+{
+    const Z_BTree_Node *node = tree->root;
+
+    while (node) {
+        bool found;
+        size_t i = z__btree_search(tree, node, key, &found);
+
+        if (found) {
+            return true;
+        }
+
+        node = node->leaf ? NULL : node->children[i];
+    }
+
+    return false;
+}
+
+// Splits the full child i of node around its median key, which moves up
+// into node. node itself must not be full.
+void z__btree_split_child(Z_BTree *tree, Z_BTree_Node *node, size_t i)
+{
+    Z_BTree_Node *child = node->children[i];
+    Z_BTree_Node *sibling = z__btree_new_node(tree->heap, child->leaf);
+
+    sibling->length = Z_BTREE_MIN_KEYS;
+    memcpy(sibling->keys, child->keys + Z_BTREE_ORDER, sizeof(void *) * Z_BTREE_MIN_KEYS);
+    memcpy(sibling->values, child->values + Z_BTREE_ORDER, sizeof(void *) * Z_BTREE_MIN_KEYS);
+
+    if (!child->leaf) {
+        memcpy(sibling->children, child->children + Z_BTREE_ORDER, sizeof(Z_BTree_Node *) * Z_BTREE_ORDER);
+    }
+
+    child->length = Z_BTREE_MIN_KEYS;
+
+    memmove(node->children + i + 2, node->children + i + 1, sizeof(Z_BTree_Node *) * (node->length - i));
+    node->children[i + 1] = sibling;
+    z__btree_insert_at(node, i, child->keys[Z_BTREE_MIN_KEYS], child->values[Z_BTREE_MIN_KEYS]);
+}
+
+// Splits full nodes on the way down, so the leaf reached always has room
+// and no node is visited twice.
+bool z_btree_put(Z_BTree *tree, void *key, void *value, Z_Pair *pair)
+{
+    if (!tree->root) {
+        tree->root = z__btree_new_node(tree->heap, true);
+    }
+
+    if (tree->root->length == Z_BTREE_MAX_KEYS) {
+        Z_BTree_Node *root = z__btree_new_node(tree->heap, false);
+        root->children[0] = tree->root;
+        z__btree_split_child(tree, root, 0);
+        tree->root = root;
+    }
+
+    Z_BTree_Node *node = tree->root;
+
+    for (;;) {
+        bool found;
+        size_t i = z__btree_search(tree, node, key, &found);
+
+        if (!found && !node->leaf && node->children[i]->length == Z_BTREE_MAX_KEYS) {
+            z__btree_split_child(tree, node, i);
+            int order = tree->compare(node->keys[i], key);
+            found = order == 0;
+            i += order < 0;
+        }
+
+        if (found) {
+            Z_Pair old = z_make_pair(node->keys[i], node->values[i]);
+            node->keys[i] = key;
+            node->values[i] = value;
+
+            if (pair) {
+                *pair = old;
+            }
+
+            return true;
+        }
+
+        if (node->leaf) {
+            z__btree_insert_at(node, i, key, value);
+            tree->size++;
+            return false;
+        }
+
+        node = node->children[i];
+    }
+}
+
+// Moves the last key of child i up into node and the separator down to the
+// front of child i + 1.
+void z__btree_rotate_right(Z_BTree_Node *node, size_t i)
+{
+    Z_BTree_Node *left = node->children[i];
+    Z_BTree_Node *right = node->children[i + 1];
+
+    if (!right->leaf) {
+        memmove(right->children + 1, right->children, sizeof(Z_BTree_Node *) * (right->length + 1u));
+        right->children[0] = left->children[left->length];
+    }
+
+    z__btree_insert_at(right, 0, node->keys[i], node->values[i]);
+    node->keys[i] = left->keys[left->length - 1];
+    node->values[i] = left->values[left->length - 1];
+    left->length--;
+}
+
+// Moves the first key of child i + 1 up into node and the separator down to
+// the back of child i.
+void z__btree_rotate_left(Z_BTree_Node *node, size_t i)
+{
+    Z_BTree_Node *left = node->children[i];
+    Z_BTree_Node *right = node->children[i + 1];
+
+    left->keys[left->length] = node->keys[i];
+    left->values[left->length] = node->values[i];
+    left->length++;
+    node->keys[i] = right->keys[0];
+    node->values[i] = right->values[0];
+
+    if (!right->leaf) {
+        left->children[left->length] = right->children[0];
+        memmove(right->children, right->children + 1, sizeof(Z_BTree_Node *) * right->length);
+    }
+
+    z__btree_remove_at(right, 0);
+}
+
+// Folds separator i and child i + 1 into child i, both children must hold
+// the minimum number of keys.
+void z__btree_merge(Z_BTree *tree, Z_BTree_Node *node, size_t i)
+{
+    Z_BTree_Node *left = node->children[i];
+    Z_BTree_Node *right = node->children[i + 1];
+
+    left->keys[left->length] = node->keys[i];
+    left->values[left->length] = node->values[i];
+    memcpy(left->keys + left->length + 1, right->keys, sizeof(void *) * right->length);
+    memcpy(left->values + left->length + 1, right->values, sizeof(void *) * right->length);
+
+    if (!left->leaf) {
+        memcpy(left->children + left->length + 1, right->children, sizeof(Z_BTree_Node *) * (right->length + 1u));
+    }
+
+    left->length = (uint16_t)(left->length + 1 + right->length);
+
+    memmove(node->children + i + 1, node->children + i + 2, sizeof(Z_BTree_Node *) * (node->length - i - 1));
+    z__btree_remove_at(node, i);
+    z_heap_free(tree->heap, right);
+}
+
+// Makes sure child i has a key to spare before descending into it, by
+// borrowing from a sibling or merging with one. Returns the index of the
+// child that now covers the same range.
+size_t z__btree_fill_child(Z_BTree *tree, Z_BTree_Node *node, size_t i)
+{
+    if (node->children[i]->length > Z_BTREE_MIN_KEYS) {
+        return i;
+    }
+
+    if (i > 0 && node->children[i - 1]->length > Z_BTREE_MIN_KEYS) {
+        z__btree_rotate_right(node, i - 1);
+        return i;
+    }
+
+    if (i < node->length && node->children[i + 1]->length > Z_BTREE_MIN_KEYS) {
+        z__btree_rotate_left(node, i);
+        return i;
+    }
+
+    if (i < node->length) {
+        z__btree_merge(tree, node, i);
+        return i;
+    }
+
+    z__btree_merge(tree, node, i - 1);
+    return i - 1;
+}
+
+// node must have a key to spare.
+Z_Pair z__btree_take_max(Z_BTree *tree, Z_BTree_Node *node)
+{
+    while (!node->leaf) {
+        node = node->children[z__btree_fill_child(tree, node, node->length)];
+    }
+
+    Z_Pair pair = z_make_pair(node->keys[node->length - 1], node->values[node->length - 1]);
+    node->length--;
+
+    return pair;
+}
+
+// node must have a key to spare.
+Z_Pair z__btree_take_min(Z_BTree *tree, Z_BTree_Node *node)
+{
+    while (!node->leaf) {
+        node = node->children[z__btree_fill_child(tree, node, 0)];
+    }
+
+    Z_Pair pair = z_make_pair(node->keys[0], node->values[0]);
+    z__btree_remove_at(node, 0);
+
+    return pair;
+}
+
+void z__btree_shrink_root(Z_BTree *tree)
+{
+    Z_BTree_Node *root = tree->root;
+
+    if (root->length > 0) {
+        return;
+    }
+
+    tree->root = root->leaf ? NULL : root->children[0];
+    z_heap_free(tree->heap, root);
+}
+
+// Single pass from the root, every child is topped up before it is entered
+// so removing a key from a leaf never leaves it below the minimum.
+bool z_btree_delete(Z_BTree *tree, const void *key, Z_Pair *pair)
+{
+    if (!tree->root) {
+        return false;
+    }
+
+    Z_BTree_Node *node = tree->root;
+    bool deleted = false;
+
+    for (;;) {
+        bool found;
+        size_t i = z__btree_search(tree, node, key, &found);
+
+        if (!found) {
+            if (node->leaf) {
+                break;
+            }
+
+            node = node->children[z__btree_fill_child(tree, node, i)];
+            continue;
+        }
+
+        if (pair) {
+            *pair = z_make_pair(node->keys[i], node->values[i]);
+        }
+
+        deleted = true;
+
+        if (node->leaf) {
+            z__btree_remove_at(node, i);
+            break;
+        }
+
+        Z_Pair replacement;
+
+        if (node->children[i]->length > Z_BTREE_MIN_KEYS) {
+            replacement = z__btree_take_max(tree, node->children[i]);
+        } else if (node->children[i + 1]->length > Z_BTREE_MIN_KEYS) {
+            replacement = z__btree_take_min(tree, node->children[i + 1]);
+        } else {
+            // the key moves down into the merged child, delete it from there
+            z__btree_merge(tree, node, i);
+            node = node->children[i];
+            deleted = false;
+            continue;
+        }
+
+        node->keys[i] = replacement.key;
+        node->values[i] = replacement.value;
+        break;
+    }
+
+    if (deleted) {
+        tree->size--;
+    }
+
+    z__btree_shrink_root(tree);
+
+    return deleted;
+}
+
+bool z_btree_min(const Z_BTree *tree, Z_Pair *pair)
+{
+    const Z_BTree_Node *node = tree->root;
+
+    if (!node) {
+        return false;
+    }
+
+    while (!node->leaf) {
+        node = node->children[0];
+    }
+
+    *pair = z_make_pair(node->keys[0], node->values[0]);
+
+    return true;
+}
+
+bool z_btree_max(const Z_BTree *tree, Z_Pair *pair)
+{
+    const Z_BTree_Node *node = tree->root;
+
+    if (!node) {
+        return false;
+    }
+
+    while (!node->leaf) {
+        node = node->children[node->length];
+    }
+
+    *pair = z_make_pair(node->keys[node->length - 1], node->values[node->length - 1]);
+
+    return true;
+}
+
+void z_btree_clear(Z_BTree *tree)
+{
+    if (tree->root) {
+        z__btree_free_node(tree->heap, tree->root);
+    }
+
+    tree->root = NULL;
+    tree->size = 0;
+}
+
+size_t z_btree_size(const Z_BTree *tree)
+{
+    return tree->size;
+}
+
+// Fills each level left to right. n keys go into ceil((n + 1) / 16) leaves
+// with one separator between every two of them, the separators then become
+// the keys of the level above, until a single node is left. Spreading the
+// keys evenly keeps every node at least half full.
+Z_BTree z_btree_from_sorted(Z_Heap *heap, Z_Compare_Fn compare, const Z_Pair *pairs, size_t count)
+{
+    Z_BTree tree = z_btree_new(heap, compare);
+
+    if (count == 0) {
+        return tree;
+    }
+
+    size_t length = (count + Z_BTREE_MAX_KEYS + 1) / (Z_BTREE_MAX_KEYS + 1);
+    Z_BTree_Node **nodes = z_heap_malloc(heap, sizeof(Z_BTree_Node *) * length);
+    Z_Pair *separators = z_heap_malloc(heap, sizeof(Z_Pair) * length);
+
+    size_t keys = count - (length - 1);
+    size_t next = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        Z_BTree_Node *leaf = z__btree_new_node(heap, true);
+        leaf->length = (uint16_t)(keys / length + (i < keys % length));
+
+        for (size_t j = 0; j < leaf->length; j++) {
+            leaf->keys[j] = pairs[next].key;
+            leaf->values[j] = pairs[next].value;
+            next++;
+        }
+
+        if (i + 1 < length) {
+            separators[i] = pairs[next++];
+        }
+
+        nodes[i] = leaf;
+    }
+
+    // parents are written over the nodes and separators already consumed
+    while (length > 1) {
+        size_t parents = (length + Z_BTREE_MAX_KEYS) / (Z_BTREE_MAX_KEYS + 1);
+        size_t child = 0;
+        size_t separator = 0;
+
+        for (size_t i = 0; i < parents; i++) {
+            Z_BTree_Node *parent = z__btree_new_node(heap, false);
+            size_t children = length / parents + (i < length % parents);
+            parent->length = (uint16_t)(children - 1);
+
+            for (size_t j = 0; j < children; j++) {
+                parent->children[j] = nodes[child++];
+            }
+
+            for (size_t j = 0; j < parent->length; j++) {
+                parent->keys[j] = separators[separator].key;
+                parent->values[j] = separators[separator].value;
+                separator++;
+            }
+
+            if (i + 1 < parents) {
+                separators[i] = separators[separator++];
+            }
+
+            nodes[i] = parent;
+        }
+
+        length = parents;
+    }
+
+    tree.root = nodes[0];
+    tree.size = count;
+
+    z_heap_free(heap, nodes);
+    z_heap_free(heap, separators);
+
+    return tree;
+}
+
+void z__btree_iter_push_leftmost(Z_BTree_Iter *iter, Z_BTree_Node *node)
+{
+    for (;;) {
+        iter->nodes[iter->depth] = node;
+        iter->indices[iter->depth] = 0;
+        iter->depth++;
+
+        if (node->leaf) {
+            return;
+        }
+
+        node = node->children[0];
+    }
+}
+
+Z_BTree_Iter z_btree_iter(const Z_BTree *tree)
+{
+    Z_BTree_Iter iter = {
+        .depth = 0,
+    };
+
+    if (tree->root) {
+        z__btree_iter_push_leftmost(&iter, tree->root);
+    }
+
+    return iter;
+}
+
+Z_BTree_Iter z_btree_lower_bound(const Z_BTree *tree, const void *key)
+{
+    Z_BTree_Iter iter = {
+        .depth = 0,
+    };
+
+    for (Z_BTree_Node *node = tree->root; node;) {
+        bool found;
+        size_t i = z__btree_search(tree, node, key, &found);
+
+        iter.nodes[iter.depth] = node;
+        iter.indices[iter.depth] = (uint8_t)i;
+        iter.depth++;
+
+        node = found || node->leaf ? NULL : node->children[i];
+    }
+
+    return iter;
+}
+
+Z_BTree_Iter z_btree_upper_bound(const Z_BTree *tree, const void *key)
+{
+    Z_BTree_Iter iter = {
+        .depth = 0,
+    };
+
+    for (Z_BTree_Node *node = tree->root; node;) {
+        size_t i = z__btree_search_upper(tree, node, key);
+
+        iter.nodes[iter.depth] = node;
+        iter.indices[iter.depth] = (uint8_t)i;
+        iter.depth++;
+
+        node = node->leaf ? NULL : node->children[i];
+    }
+
+    return iter;
+}
+
+bool z_btree_iter_next(Z_BTree_Iter *iter, Z_Pair *pair)
+{
+    while (iter->depth > 0) {
+        Z_BTree_Node *node = iter->nodes[iter->depth - 1];
+        size_t i = iter->indices[iter->depth - 1];
+
+        if (i == node->length) {
+            iter->depth--;
+            continue;
+        }
+
+        *pair = z_make_pair(node->keys[i], node->values[i]);
+        iter->indices[iter->depth - 1] = (uint8_t)(i + 1);
+
+        if (!node->leaf) {
+            z__btree_iter_push_leftmost(iter, node->children[i + 1]);
+        }
+
+        return true;
+    }
+
+    return false;
+}
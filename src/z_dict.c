@@ -0,0 +1,332 @@
+#include <z_dict.h>
+#include <internal/z_config.h>
+#include <internal/z_group.h>
+#include <internal/z_math.h>
+
+#define Z_DICT_NOT_FOUND SIZE_MAX
+
+// deleted entries point their key here
+static char z__dict_hole;
+
+Z_Dict z__dict_new_exact(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity);
+void z__dict_alloc_index(Z_Dict *dict, size_t capacity);
+size_t z__dict_find(const Z_Dict *dict, const void *key, size_t hash);
+void z__dict_index_entry(Z_Dict *dict, size_t i, size_t hash);
+void z__dict_rebuild(Z_Dict *dict, size_t new_capacity);
+void z__dict_make_room(Z_Dict *dict);
+
+Z_Dict z_dict_new(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash)
+{
+    return z__dict_new_exact(heap, equal, hash, 0);
+}
+
+Z_Dict z_dict_new_with_capacity(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity)
+{
+    Z_Dict dict = z__dict_new_exact(heap, equal, hash, z__hash_table_capacity_for(capacity));
+
+    if (capacity > 0) {
+        dict.entries = z_heap_malloc(heap, sizeof(Z_Pair) * capacity);
+        dict.entries_capacity = capacity;
+    }
+
+    return dict;
+}
+
+Z_Dict z__dict_new_exact(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity)
+{
+    Z_Dict dict = {
+        .ctrl = NULL,
+        .indices = NULL,
+        .entries = NULL,
+        .entries_length = 0,
+        .entries_capacity = 0,
+        .occupied = 0,
+        .size = 0,
+        .capacity = 0,
+        .equal = equal,
+        .hash = hash,
+        .heap = heap,
+    };
+
+    z__dict_alloc_index(&dict, capacity);
+
+    return dict;
+}
+
+void z__dict_alloc_index(Z_Dict *dict, size_t capacity)
+{
+    if (dict->capacity != capacity && dict->capacity > 0) {
+        z_heap_free(dict->heap, dict->ctrl);
+        z_heap_free(dict->heap, dict->indices);
+        dict->ctrl = NULL;
+        dict->indices = NULL;
+    }
+
+    if (dict->capacity != capacity && capacity > 0) {
+        dict->ctrl = z_heap_malloc(dict->heap, capacity + Z_GROUP_WIDTH);
+        dict->indices = z_heap_malloc(dict->heap, sizeof(uint32_t) * capacity);
+    }
+
+    if (capacity > 0) {
+        memset(dict->ctrl, Z_CTRL_EMPTY, capacity + Z_GROUP_WIDTH);
+    }
+
+    dict->capacity = capacity;
+    dict->occupied = 0;
+}
+
+Z_Dict z_dict_clone(Z_Heap *heap, const Z_Dict *dict)
+{
+    Z_Dict clone = z__dict_new_exact(heap, dict->equal, dict->hash, dict->capacity);
+
+    if (dict->capacity > 0) {
+        memcpy(clone.ctrl, dict->ctrl, dict->capacity + Z_GROUP_WIDTH);
+        memcpy(clone.indices, dict->indices, sizeof(uint32_t) * dict->capacity);
+    }
+
+    if (dict->entries_length > 0) {
+        clone.entries = z_heap_malloc(heap, sizeof(Z_Pair) * dict->entries_length);
+        memcpy(clone.entries, dict->entries, sizeof(Z_Pair) * dict->entries_length);
+    }
+
+    clone.entries_length = dict->entries_length;
+    clone.entries_capacity = dict->entries_length;
+    clone.occupied = dict->occupied;
+    clone.size = dict->size;
+
+    return clone;
+}
+
+static inline size_t z__dict_hash(const Z_Dict *dict, const void *key)
+{
+    return z__group_mix(dict->hash(key));
+}
+
+size_t z__dict_find(const Z_Dict *dict, const void *key, size_t hash)
+{
+    if (dict->capacity == 0) {
+        return Z_DICT_NOT_FOUND;
+    }
+
+    uint8_t h2 = z__group_h2(hash);
+
+    for (Z_Group_Probe probe = z__group_probe(hash, dict->capacity);; z__group_probe_next(&probe)) {
+        Z_Group_Mask match = z__group_match(dict->ctrl + probe.pos, h2);
+
+        while (match) {
+            size_t i = z__group_probe_slot(&probe, z__group_mask_next(&match));
+
+            if (dict->equal(dict->entries[dict->indices[i]].key, key)) {
+                return i;
+            }
+        }
+
+        if (z__group_match_empty(dict->ctrl + probe.pos)) {
+            return Z_DICT_NOT_FOUND;
+        }
+    }
+}
+
+// points a free slot of the index at entries[i]
+void z__dict_index_entry(Z_Dict *dict, size_t i, size_t hash)
+{
+    size_t slot = z__group_find_insert_slot(dict->ctrl, dict->capacity, hash);
+
+    if (dict->ctrl[slot] == Z_CTRL_EMPTY) {
+        dict->occupied++;
+    }
+
+    z__ctrl_set(dict->ctrl, dict->capacity, slot, z__group_h2(hash));
+    dict->indices[slot] = (uint32_t)i;
+}
+
+// Squeezes the holes out of entries and indexes them again from scratch.
+void z__dict_rebuild(Z_Dict *dict, size_t new_capacity)
+{
+    size_t length = 0;
+
+    for (size_t i = 0; i < dict->entries_length; i++) {
+        if (dict->entries[i].key != &z__dict_hole) {
+            dict->entries[length++] = dict->entries[i];
+        }
+    }
+
+    dict->entries_length = length;
+    z__dict_alloc_index(dict, new_capacity);
+
+    for (size_t i = 0; i < length; i++) {
+        z__dict_index_entry(dict, i, z__dict_hash(dict, dict->entries[i].key));
+    }
+}
+
+// Called before appending an entry, when either the index or entries is
+// full. Holes in entries and deleted slots in the index are reclaimed
+// first, the index only doubles when live pairs fill half of it.
+void z__dict_make_room(Z_Dict *dict)
+{
+    bool index_full = (double)dict->occupied >= (double)dict->capacity * Z_HASH_TABLE_MAX_LOAD_FACTOR;
+    bool mostly_holes = dict->size <= dict->entries_length / 2;
+
+    if (index_full || mostly_holes) {
+        size_t new_capacity = dict->capacity;
+
+        if (dict->capacity == 0 || (double)dict->size > (double)dict->capacity * Z_HASH_TABLE_MAX_LOAD_FACTOR / 2) {
+            new_capacity = z__max_size_t(Z_HASH_TABLE_MIN_CAPACITY, dict->capacity * 2);
+        }
+
+        z__dict_rebuild(dict, new_capacity);
+    }
+
+    if (dict->entries_length == dict->entries_capacity) {
+        size_t new_capacity = z__max_size_t(Z_HASH_TABLE_MIN_CAPACITY, dict->entries_capacity * Z_BUFFER_GROWTH_FACTOR);
+        dict->entries = z_heap_realloc(dict->heap, dict->entries, sizeof(Z_Pair) * new_capacity);
+        dict->entries_capacity = new_capacity;
+    }
+}
+
+void *z_dict_try_get(const Z_Dict *dict, const void *key, void *fallback)
+{
+    if (dict->size == 0) {
+        return fallback;
+    }
+
+    size_t i = z__dict_find(dict, key, z__dict_hash(dict, key));
+
+    if (i == Z_DICT_NOT_FOUND) {
+        return fallback;
+    }
+
+    return dict->entries[dict->indices[i]].value;
+}
+
+void *z_dict_get(const Z_Dict *dict, const void *key)
+{
+    return z_dict_try_get(dict, key, NULL);
+}
+
+// a key put again keeps its original position
+bool z_dict_put(Z_Dict *dict, void *key, void *value, Z_Pair *pair)
+{
+    size_t hash = z__dict_hash(dict, key);
+    size_t i = z__dict_find(dict, key, hash);
+
+    if (i != Z_DICT_NOT_FOUND) {
+        Z_Pair *entry = &dict->entries[dict->indices[i]];
+
+        if (pair) {
+            *pair = *entry;
+        }
+
+        *entry = z_make_pair(key, value);
+        return true;
+    }
+
+    if ((double)dict->occupied >= (double)dict->capacity * Z_HASH_TABLE_MAX_LOAD_FACTOR
+        || dict->entries_length == dict->entries_capacity) {
+        z__dict_make_room(dict);
+    }
+
+    dict->entries[dict->entries_length] = z_make_pair(key, value);
+    z__dict_index_entry(dict, dict->entries_length, hash);
+    dict->entries_length++;
+    dict->size++;
+
+    return false;
+}
+
+bool z_dict_delete(Z_Dict *dict, const void *key, Z_Pair *pair)
+{
+    if (dict->size == 0) {
+        return false;
+    }
+
+    size_t i = z__dict_find(dict, key, z__dict_hash(dict, key));
+
+    if (i == Z_DICT_NOT_FOUND) {
+        return false;
+    }
+
+    size_t entry = dict->indices[i];
+
+    if (pair) {
+        *pair = dict->entries[entry];
+    }
+
+    if (z__ctrl_erase(dict->ctrl, dict->capacity, i)) {
+        dict->occupied--;
+    }
+
+    dict->entries[entry].key = &z__dict_hole;
+    dict->size--;
+
+    while (dict->entries_length > 0 && dict->entries[dict->entries_length - 1].key == &z__dict_hole) {
+        dict->entries_length--;
+    }
+
+    return true;
+}
+
+bool z_dict_contains(const Z_Dict *dict, const void *key)
+{
+    if (dict->size == 0) {
+        return false;
+    }
+
+    return z__dict_find(dict, key, z__dict_hash(dict, key)) != Z_DICT_NOT_FOUND;
+}
+
+size_t z_dict_size(const Z_Dict *dict)
+{
+    return dict->size;
+}
+
+void z_dict_clear(Z_Dict *dict)
+{
+    if (dict->capacity > 0) {
+        memset(dict->ctrl, Z_CTRL_EMPTY, dict->capacity + Z_GROUP_WIDTH);
+    }
+
+    dict->entries_length = 0;
+    dict->occupied = 0;
+    dict->size = 0;
+}
+
+Z_Pair_Array z_dict_to_array(Z_Heap *heap, const Z_Dict *dict)
+{
+    Z_Pair_Array array = z_array_new(heap, Z_Pair_Array);
+    z_array_ensure_capacity(&array, dict->size);
+
+    for (size_t i = 0; i < dict->entries_length; i++) {
+        if (dict->entries[i].key != &z__dict_hole) {
+            array.ptr[array.length++] = dict->entries[i];
+        }
+    }
+
+    return array;
+}
+
+Z_Dict_Iter z_dict_iter(const Z_Dict *dict)
+{
+    Z_Dict_Iter iter = {
+        .dict = dict,
+        .i = 0,
+    };
+
+    return iter;
+}
+
+bool z_dict_iter_next(Z_Dict_Iter *iter, Z_Pair *pair)
+{
+    const Z_Dict *dict = iter->dict;
+
+    while (iter->i < dict->entries_length) {
+        Z_Pair entry = dict->entries[iter->i++];
+
+        if (entry.key != &z__dict_hole) {
+            *pair = entry;
+            return true;
+        }
+    }
+
+    return false;
+}
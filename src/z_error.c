@@ -3,7 +3,7 @@
 #include <z_string.h>
 #include <stdio.h>
 
-void z_die_va(const char *format, va_list args);
+__attribute__((noreturn)) void z_die_va(const char *format, va_list args);
 void z_perror_format_va(const char *format, va_list args);
 
 void z_die(const char *format, ...)
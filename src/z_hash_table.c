@@ -1,8 +1,37 @@
 #include <z_hash_table.h>
+#include <internal/z_group.h>
+#include <internal/z_math.h>
+#include <pthread.h>
+#include <z_error.h>
 
+#define Z_HASH_TABLE_NOT_FOUND SIZE_MAX
+
+struct Z_Hash_Table_Stripe {
+    _Alignas(64) pthread_mutex_t lock;
+    Z_Heap heap;
+    Z_Hash_Table table;
+};
+
+__extension__ typedef unsigned __int128 z__u128;
+
+// kept already passed through z__hash_seed_mix(), this is seed 0
+static uint64_t z__hash_seed = 0xca813bf4c7abf0a9;
+static uint64_t z__hash_seed_raw = 0;
+
+Z_Hash_Table z__hash_table_new_exact(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity);
 void z__hash_table_free(Z_Hash_Table *table);
+size_t z__hash_table_find(const Z_Hash_Table *table, const void *key, size_t hash);
+void z__hash_table_insert_at(Z_Hash_Table *table, size_t i, void *key, void *value, size_t hash);
 bool z__hash_table_put_no_resize(Z_Hash_Table *table, void *key, void *value, size_t hash, Z_Pair *pair);
 void z__hash_table_resize(Z_Hash_Table *table, size_t new_capacity);
+size_t z__hash_table_slot_hash(const void *table, size_t i);
+void z__hash_table_swap_slots(void *table, size_t a, size_t b);
+void z__hash_table_rehash_in_place(Z_Hash_Table *table);
+void z__hash_table_make_room(Z_Hash_Table *table);
+void z__hash_table_prefetch_batch(const Z_Hash_Table *table, void *const *keys, size_t count, size_t *hashes);
+bool z__hash_table_delete_hashed(Z_Hash_Table *table, const void *key, size_t hash, Z_Pair *pair);
+void z__hash_table_add_probe_stats(const Z_Hash_Table *table, Z_Hash_Table_Probe_Stats *stats);
+Z_Hash_Table_Stripe *z__concurrent_hash_table_stripe_of(const Z_Concurrent_Hash_Table *table, size_t hash);
 
 Z_Pair z_make_pair(void *key, void *value)
 {
@@ -14,17 +43,37 @@ Z_Pair z_make_pair(void *key, void *value)
     return pair;
 }
 
+size_t z__hash_table_capacity_for(size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t capacity = Z_HASH_TABLE_MIN_CAPACITY;
+
+    while ((double)size > (double)capacity * Z_HASH_TABLE_MAX_LOAD_FACTOR) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
 Z_Hash_Table z_hash_table_new(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash)
 {
     return z_hash_table_new_with_capacity(heap, equal, hash, 0);
 }
 
 Z_Hash_Table z_hash_table_new_with_capacity(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity)
+{
+    return z__hash_table_new_exact(heap, equal, hash, z__hash_table_capacity_for(capacity));
+}
+
+Z_Hash_Table z__hash_table_new_exact(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity)
 {
     Z_Hash_Table table = {
-        .keys = z_heap_calloc(heap, sizeof(void *) * capacity),
-        .values = z_heap_calloc(heap, sizeof(void *) * capacity),
-        .hashes = z_heap_calloc(heap, sizeof(size_t) * capacity),
+        .ctrl = NULL,
+        .keys = NULL,
+        .values = NULL,
         .occupied = 0,
         .size = 0,
         .capacity = capacity,
@@ -33,6 +82,13 @@ Z_Hash_Table z_hash_table_new_with_capacity(Z_Heap *heap, Z_Equal_Fn equal, Z_Ha
         .heap = heap,
     };
 
+    if (capacity > 0) {
+        table.ctrl = z_heap_malloc(heap, capacity + Z_GROUP_WIDTH);
+        table.keys = z_heap_malloc(heap, sizeof(void *) * capacity);
+        table.values = z_heap_malloc(heap, sizeof(void *) * capacity);
+        memset(table.ctrl, Z_CTRL_EMPTY, capacity + Z_GROUP_WIDTH);
+    }
+
     return table;
 }
 
@@ -42,20 +98,14 @@ void z__hash_table_free(Z_Hash_Table *table)
         return;
     }
 
+    z_heap_free(table->heap, table->ctrl);
     z_heap_free(table->heap, table->keys);
     z_heap_free(table->heap, table->values);
-    z_heap_free(table->heap, table->hashes);
 }
 
 static inline size_t z__hash_table_hash(const Z_Hash_Table *table, const void *key)
 {
-    size_t hash = table->hash(key);
-
-    if (hash < 2) {
-        return hash + 2;
-    }
-
-    return hash;
+    return z__group_mix(table->hash(key));
 }
 
 static inline float z__hash_table_get_load_factor(const Z_Hash_Table *table)
@@ -67,81 +117,93 @@ static inline float z__hash_table_get_load_factor(const Z_Hash_Table *table)
     return (float)table->occupied / (float)table->capacity;
 }
 
-void *z_hash_table_try_get(const Z_Hash_Table *table, const void *key, void *fallback)
+size_t z__hash_table_find(const Z_Hash_Table *table, const void *key, size_t hash)
 {
     if (table->capacity == 0) {
-        return fallback;
+        return Z_HASH_TABLE_NOT_FOUND;
     }
 
-    size_t hash = z__hash_table_hash(table, key);
-    size_t i = hash % table->capacity;
+    uint8_t h2 = z__group_h2(hash);
 
-    while (table->hashes[i] != Z_HASH_TABLE_EMPTY) {
+    for (Z_Group_Probe probe = z__group_probe(hash, table->capacity);; z__group_probe_next(&probe)) {
+        Z_Group_Mask match = z__group_match(table->ctrl + probe.pos, h2);
 
-        if (table->hashes[i] == hash && table->equal(table->keys[i], key)) {
-            return table->values[i];
+        while (match) {
+            size_t i = z__group_probe_slot(&probe, z__group_mask_next(&match));
+
+            if (table->equal(table->keys[i], key)) {
+                return i;
+            }
         }
 
-        i = (i + 1) % table->capacity;
+        if (z__group_match_empty(table->ctrl + probe.pos)) {
+            return Z_HASH_TABLE_NOT_FOUND;
+        }
     }
-
-    return fallback;
 }
 
-void *z_hash_table_get(const Z_Hash_Table *table, const void *key)
+void z__hash_table_insert_at(Z_Hash_Table *table, size_t i, void *key, void *value, size_t hash)
 {
-    return z_hash_table_try_get(table, key, NULL);
+    if (table->ctrl[i] == Z_CTRL_EMPTY) {
+        table->occupied++;
+    }
+
+    z__ctrl_set(table->ctrl, table->capacity, i, z__group_h2(hash));
+    table->keys[i] = key;
+    table->values[i] = value;
+    table->size++;
 }
 
-bool z__hash_table_put_no_resize(Z_Hash_Table *table, void *key, void *value, size_t hash, Z_Pair *pair)
+void *z_hash_table_try_get(const Z_Hash_Table *table, const void *key, void *fallback)
 {
-    size_t i = hash % table->capacity;
-    ssize_t first_tompstone = -1;
-
-    while (table->hashes[i] != Z_HASH_TABLE_EMPTY) {
+    if (table->capacity == 0) {
+        return fallback;
+    }
 
-        if (first_tompstone == -1 && table->hashes[i] == Z_HASH_TABLE_TOMBSTONE) {
-            first_tompstone = (ssize_t)i;
-        }
+    size_t i = z__hash_table_find(table, key, z__hash_table_hash(table, key));
 
-        if (table->hashes[i] == hash && table->equal(table->keys[i], key)) {
-            Z_Pair old = z_make_pair(table->keys[i], table->values[i]);
-            table->keys[i] = key;
-            table->values[i] = value;
+    if (i == Z_HASH_TABLE_NOT_FOUND) {
+        return fallback;
+    }
 
-            if (pair) {
-                *pair = old;
-            }
+    return table->values[i];
+}
 
-            return true;
-        }
+void *z_hash_table_get(const Z_Hash_Table *table, const void *key)
+{
+    return z_hash_table_try_get(table, key, NULL);
+}
 
-        i = (i + 1) % table->capacity;
-    }
+bool z__hash_table_put_no_resize(Z_Hash_Table *table, void *key, void *value, size_t hash, Z_Pair *pair)
+{
+    size_t i = z__hash_table_find(table, key, hash);
 
-    if (first_tompstone == -1) {
+    if (i != Z_HASH_TABLE_NOT_FOUND) {
+        Z_Pair old = z_make_pair(table->keys[i], table->values[i]);
         table->keys[i] = key;
         table->values[i] = value;
-        table->hashes[i] = hash;
-        table->occupied++;
-    } else {
-        table->keys[first_tompstone] = key;
-        table->values[first_tompstone] = value;
-        table->hashes[first_tompstone] = hash;
+
+        if (pair) {
+            *pair = old;
+        }
+
+        return true;
     }
 
-    table->size++;
+    z__hash_table_insert_at(table, z__group_find_insert_slot(table->ctrl, table->capacity, hash), key, value, hash);
 
     return false;
 }
 
 void z__hash_table_resize(Z_Hash_Table *table, size_t new_capacity)
 {
-    Z_Hash_Table new_table = z_hash_table_new_with_capacity(table->heap, table->equal, table->hash, new_capacity);
+    Z_Hash_Table new_table = z__hash_table_new_exact(table->heap, table->equal, table->hash, new_capacity);
 
     for (size_t i = 0; i < table->capacity; i++) {
-        if (table->hashes[i] >= 2) {
-            z__hash_table_put_no_resize(&new_table, table->keys[i], table->values[i], table->hashes[i], NULL);
+        if (z__ctrl_is_full(table->ctrl[i])) {
+            size_t hash = z__hash_table_hash(table, table->keys[i]);
+            size_t slot = z__group_find_insert_slot(new_table.ctrl, new_table.capacity, hash);
+            z__hash_table_insert_at(&new_table, slot, table->keys[i], table->values[i], hash);
         }
     }
 
@@ -149,35 +211,145 @@ void z__hash_table_resize(Z_Hash_Table *table, size_t new_capacity)
     *table = new_table;
 }
 
+size_t z__hash_table_slot_hash(const void *table, size_t i)
+{
+    const Z_Hash_Table *t = table;
+    return z__hash_table_hash(t, t->keys[i]);
+}
+
+void z__hash_table_swap_slots(void *table, size_t a, size_t b)
+{
+    Z_Hash_Table *t = table;
+    void *key = t->keys[a];
+    void *value = t->values[a];
+    t->keys[a] = t->keys[b];
+    t->values[a] = t->values[b];
+    t->keys[b] = key;
+    t->values[b] = value;
+}
+
+void z__hash_table_rehash_in_place(Z_Hash_Table *table)
+{
+    z__group_rehash_in_place(table->ctrl, table->capacity, table, z__hash_table_slot_hash, z__hash_table_swap_slots);
+    table->occupied = table->size;
+}
+
+// Called when a put would cross the load factor. When deleted slots, not
+// live elements, are what filled the table it gets rehashed in place at the
+// same capacity instead of doubling.
+void z__hash_table_make_room(Z_Hash_Table *table)
+{
+    if (table->capacity > 0 && (double)table->size <= (double)table->capacity * Z_HASH_TABLE_MAX_LOAD_FACTOR / 2) {
+        z__hash_table_rehash_in_place(table);
+    } else {
+        z__hash_table_resize(table, z__max_size_t(Z_HASH_TABLE_MIN_CAPACITY, table->capacity * 2));
+    }
+}
+
 bool z_hash_table_put(Z_Hash_Table *table, void *key, void *value, Z_Pair *pair)
 {
     if (z__hash_table_get_load_factor(table) >= Z_HASH_TABLE_MAX_LOAD_FACTOR) {
-        size_t new_capacity = z__max_size_t(Z_HASH_TABLE_MIN_CAPACITY, table->capacity * 2);
-        z__hash_table_resize(table, new_capacity);
+        z__hash_table_make_room(table);
     }
 
     size_t hash = z__hash_table_hash(table, key);
     return z__hash_table_put_no_resize(table, key, value, hash, pair);
 }
 
+void z_hash_table_reserve(Z_Hash_Table *table, size_t size)
+{
+    size_t new_capacity = z__hash_table_capacity_for(size);
+
+    if (new_capacity > table->capacity) {
+        z__hash_table_resize(table, new_capacity);
+    }
+}
+
+// Hashes a batch of keys and prefetches the first group of each before any
+// of them is compared, so the cache misses overlap instead of following one
+// another.
+void z__hash_table_prefetch_batch(const Z_Hash_Table *table, void *const *keys, size_t count, size_t *hashes)
+{
+    size_t mask = table->capacity - 1;
+
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = z__hash_table_hash(table, keys[i]);
+        size_t pos = z__group_h1(hashes[i]) & mask;
+        __builtin_prefetch(table->ctrl + pos);
+        __builtin_prefetch(table->keys + pos);
+    }
+}
+
+size_t z_hash_table_get_batch(const Z_Hash_Table *table, void *const *keys, size_t count, void **values)
+{
+    size_t hashes[Z_HASH_TABLE_BATCH_SIZE];
+    size_t found = 0;
+
+    if (table->capacity == 0) {
+        memset(values, 0, sizeof(void *) * count);
+        return 0;
+    }
+
+    for (size_t start = 0; start < count; start += Z_HASH_TABLE_BATCH_SIZE) {
+        size_t length = z__min_size_t(count - start, Z_HASH_TABLE_BATCH_SIZE);
+        z__hash_table_prefetch_batch(table, keys + start, length, hashes);
+
+        for (size_t i = 0; i < length; i++) {
+            size_t slot = z__hash_table_find(table, keys[start + i], hashes[i]);
+
+            if (slot == Z_HASH_TABLE_NOT_FOUND) {
+                values[start + i] = NULL;
+            } else {
+                values[start + i] = table->values[slot];
+                found++;
+            }
+        }
+    }
+
+    return found;
+}
+
+void z_hash_table_put_batch(Z_Hash_Table *table, void *const *keys, void *const *values, size_t count)
+{
+    size_t hashes[Z_HASH_TABLE_BATCH_SIZE];
+
+    z_hash_table_reserve(table, table->size + count);
+
+    for (size_t start = 0; start < count; start += Z_HASH_TABLE_BATCH_SIZE) {
+        size_t length = z__min_size_t(count - start, Z_HASH_TABLE_BATCH_SIZE);
+        z__hash_table_prefetch_batch(table, keys + start, length, hashes);
+
+        for (size_t i = 0; i < length; i++) {
+            if (z__hash_table_get_load_factor(table) >= Z_HASH_TABLE_MAX_LOAD_FACTOR) {
+                z__hash_table_make_room(table);
+            }
+
+            z__hash_table_put_no_resize(table, keys[start + i], values[start + i], hashes[i], NULL);
+        }
+    }
+}
+
 bool z_hash_table_delete(Z_Hash_Table *table, void *key, Z_Pair *pair)
 {
     if (table->size == 0) {
         return false;
     }
 
-    size_t hash = z__hash_table_hash(table, key);
-    size_t i = hash % table->capacity;
+    return z__hash_table_delete_hashed(table, key, z__hash_table_hash(table, key), pair);
+}
 
-    while (table->hashes[i] != Z_HASH_TABLE_EMPTY && (table->hashes[i] != hash || !table->equal(key, table->keys[i]))) {
-        i = (i + 1) % table->capacity;
-    }
+bool z__hash_table_delete_hashed(Z_Hash_Table *table, const void *key, size_t hash, Z_Pair *pair)
+{
+    size_t i = z__hash_table_find(table, key, hash);
 
-    if (table->hashes[i] == Z_HASH_TABLE_EMPTY) {
+    if (i == Z_HASH_TABLE_NOT_FOUND) {
         return false;
     }
 
-    table->hashes[i] = Z_HASH_TABLE_TOMBSTONE;
+    if (z__ctrl_erase(table->ctrl, table->capacity, i)) {
+        table->occupied--;
+    }
+
     table->size--;
 
     if (pair) {
@@ -193,18 +365,28 @@ bool z_hash_table_contains(const Z_Hash_Table *table, void *key)
         return false;
     }
 
-    size_t hash = z__hash_table_hash(table, key);
-    size_t i = hash % table->capacity;
-
-    while (table->hashes[i] != Z_HASH_TABLE_EMPTY) {
-        if (table->hashes[i] == hash && table->equal(key, table->keys[i])) {
-            return true;
-        }
+    return z__hash_table_find(table, key, z__hash_table_hash(table, key)) != Z_HASH_TABLE_NOT_FOUND;
+}
 
-        i = (i + 1) % table->capacity;
+void z_hash_table_clear(Z_Hash_Table *table)
+{
+    if (table->capacity > 0) {
+        memset(table->ctrl, Z_CTRL_EMPTY, table->capacity + Z_GROUP_WIDTH);
     }
 
-    return false;
+    table->occupied = 0;
+    table->size = 0;
+}
+
+void z_hash_table_shrink_to_fit(Z_Hash_Table *table)
+{
+    size_t new_capacity = z__hash_table_capacity_for(table->size);
+
+    if (new_capacity < table->capacity) {
+        z__hash_table_resize(table, new_capacity);
+    } else if (table->occupied > table->size) {
+        z__hash_table_rehash_in_place(table);
+    }
 }
 
 size_t z_hash_table_size(const Z_Hash_Table *table)
@@ -215,9 +397,10 @@ size_t z_hash_table_size(const Z_Hash_Table *table)
 Z_Pair_Array z_hash_table_to_array(Z_Heap *heap, const Z_Hash_Table *table)
 {
     Z_Pair_Array array = z_array_new(heap, Z_Pair_Array);
+    z_array_ensure_capacity(&array, table->size);
 
     for (size_t i = 0; i < table->capacity; i++) {
-        if (table->hashes[i] >= 2) {
+        if (z__ctrl_is_full(table->ctrl[i])) {
             z_array_push(&array, z_make_pair(table->keys[i], table->values[i]));
         }
     }
@@ -241,7 +424,7 @@ bool z_hash_table_iter_next(Z_Hash_Table_Iter *iter, Z_Pair *pair)
     size_t *i = &iter->i;
 
     while (*i < ht->capacity) {
-        if (ht->hashes[*i] >= 2) {
+        if (z__ctrl_is_full(ht->ctrl[*i])) {
             *pair = z_make_pair(ht->keys[*i], ht->values[*i]);
             (*i)++;
             return true;
@@ -253,18 +436,321 @@ bool z_hash_table_iter_next(Z_Hash_Table_Iter *iter, Z_Pair *pair)
     return false;
 }
 
+Z_Concurrent_Hash_Table z_concurrent_hash_table_new(Z_Equal_Fn equal, Z_Hash_Fn hash)
+{
+    Z_Concurrent_Hash_Table table = {
+        .stripes = aligned_alloc(_Alignof(Z_Hash_Table_Stripe), sizeof(Z_Hash_Table_Stripe) * Z_HASH_TABLE_STRIPE_COUNT),
+        .equal = equal,
+        .hash = hash,
+    };
+
+    if (table.stripes == NULL) {
+        z_die("z_concurrent_hash_table: out of memory\n");
+    }
+
+    for (size_t i = 0; i < Z_HASH_TABLE_STRIPE_COUNT; i++) {
+        Z_Hash_Table_Stripe *stripe = &table.stripes[i];
+        pthread_mutex_init(&stripe->lock, NULL);
+        stripe->heap = z_heap_new();
+        stripe->table = z_hash_table_new(&stripe->heap, equal, hash);
+    }
+
+    return table;
+}
+
+void z_concurrent_hash_table_free(Z_Concurrent_Hash_Table *table)
+{
+    for (size_t i = 0; i < Z_HASH_TABLE_STRIPE_COUNT; i++) {
+        z_heap_free_all(&table->stripes[i].heap);
+        pthread_mutex_destroy(&table->stripes[i].lock);
+    }
+
+    free(table->stripes);
+    table->stripes = NULL;
+}
+
+// the low bits of the hash pick the slot inside a stripe, so the stripe is
+// picked by the top ones
+Z_Hash_Table_Stripe *z__concurrent_hash_table_stripe_of(const Z_Concurrent_Hash_Table *table, size_t hash)
+{
+    return &table->stripes[hash >> (sizeof(size_t) * 8 - Z_HASH_TABLE_STRIPE_BITS)];
+}
+
+void *z_concurrent_hash_table_try_get(const Z_Concurrent_Hash_Table *table, const void *key, void *fallback)
+{
+    size_t hash = z__group_mix(table->hash(key));
+    Z_Hash_Table_Stripe *stripe = z__concurrent_hash_table_stripe_of(table, hash);
+    void *value = fallback;
+
+    pthread_mutex_lock(&stripe->lock);
+    size_t i = z__hash_table_find(&stripe->table, key, hash);
+
+    if (i != Z_HASH_TABLE_NOT_FOUND) {
+        value = stripe->table.values[i];
+    }
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    return value;
+}
+
+void *z_concurrent_hash_table_get(const Z_Concurrent_Hash_Table *table, const void *key)
+{
+    return z_concurrent_hash_table_try_get(table, key, NULL);
+}
+
+bool z_concurrent_hash_table_put(Z_Concurrent_Hash_Table *table, void *key, void *value, Z_Pair *pair)
+{
+    size_t hash = z__group_mix(table->hash(key));
+    Z_Hash_Table_Stripe *stripe = z__concurrent_hash_table_stripe_of(table, hash);
+
+    pthread_mutex_lock(&stripe->lock);
+
+    if (z__hash_table_get_load_factor(&stripe->table) >= Z_HASH_TABLE_MAX_LOAD_FACTOR) {
+        z__hash_table_make_room(&stripe->table);
+    }
+
+    bool replaced = z__hash_table_put_no_resize(&stripe->table, key, value, hash, pair);
+    pthread_mutex_unlock(&stripe->lock);
+
+    return replaced;
+}
+
+bool z_concurrent_hash_table_delete(Z_Concurrent_Hash_Table *table, void *key, Z_Pair *pair)
+{
+    size_t hash = z__group_mix(table->hash(key));
+    Z_Hash_Table_Stripe *stripe = z__concurrent_hash_table_stripe_of(table, hash);
+
+    pthread_mutex_lock(&stripe->lock);
+    bool deleted = stripe->table.size > 0 && z__hash_table_delete_hashed(&stripe->table, key, hash, pair);
+    pthread_mutex_unlock(&stripe->lock);
+
+    return deleted;
+}
+
+bool z_concurrent_hash_table_contains(const Z_Concurrent_Hash_Table *table, void *key)
+{
+    size_t hash = z__group_mix(table->hash(key));
+    Z_Hash_Table_Stripe *stripe = z__concurrent_hash_table_stripe_of(table, hash);
+
+    pthread_mutex_lock(&stripe->lock);
+    bool found = z__hash_table_find(&stripe->table, key, hash) != Z_HASH_TABLE_NOT_FOUND;
+    pthread_mutex_unlock(&stripe->lock);
+
+    return found;
+}
+
+size_t z_concurrent_hash_table_size(const Z_Concurrent_Hash_Table *table)
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < Z_HASH_TABLE_STRIPE_COUNT; i++) {
+        pthread_mutex_lock(&table->stripes[i].lock);
+        size += table->stripes[i].table.size;
+        pthread_mutex_unlock(&table->stripes[i].lock);
+    }
+
+    return size;
+}
+
+void z__probe_stats_add(Z_Hash_Table_Probe_Stats *stats, size_t length)
+{
+    stats->max = z__max_size_t(stats->max, length);
+    stats->mean += (double)length;
+    stats->histogram[z__min_size_t(length, Z_HASH_TABLE_PROBE_HISTOGRAM_SIZE) - 1]++;
+}
+
+// a miss stops at the first group holding an empty slot
+void z__probe_stats_add_misses(Z_Hash_Table_Probe_Stats *stats, const uint8_t *ctrl, size_t capacity)
+{
+    size_t mask = capacity - 1;
+
+    for (size_t start = 0; start < capacity; start++) {
+        size_t pos = start;
+        size_t length = 1;
+
+        for (size_t step = Z_GROUP_WIDTH; !z__group_match_empty(ctrl + pos); step += Z_GROUP_WIDTH) {
+            pos = (pos + step) & mask;
+            length++;
+        }
+
+        stats->mean_miss += (double)length;
+    }
+}
+
+void z__probe_stats_finish(Z_Hash_Table_Probe_Stats *stats, size_t size, size_t capacity)
+{
+    stats->mean = size > 0 ? stats->mean / (double)size : 0;
+    stats->mean_miss = capacity > 0 ? stats->mean_miss / (double)capacity : 0;
+}
+
+void z__hash_table_add_probe_stats(const Z_Hash_Table *table, Z_Hash_Table_Probe_Stats *stats)
+{
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (z__ctrl_is_full(table->ctrl[i])) {
+            size_t hash = z__hash_table_hash(table, table->keys[i]);
+            z__probe_stats_add(stats, z__group_probe_length(i, hash, table->capacity));
+        }
+    }
+
+    z__probe_stats_add_misses(stats, table->ctrl, table->capacity);
+}
+
+Z_Hash_Table_Probe_Stats z_hash_table_probe_stats(const Z_Hash_Table *table)
+{
+    Z_Hash_Table_Probe_Stats stats = {0};
+
+    z__hash_table_add_probe_stats(table, &stats);
+    z__probe_stats_finish(&stats, table->size, table->capacity);
+
+    return stats;
+}
+
+Z_Hash_Table_Probe_Stats z_concurrent_hash_table_probe_stats(const Z_Concurrent_Hash_Table *table)
+{
+    Z_Hash_Table_Probe_Stats stats = {0};
+    size_t size = 0;
+    size_t capacity = 0;
+
+    for (size_t i = 0; i < Z_HASH_TABLE_STRIPE_COUNT; i++) {
+        Z_Hash_Table_Stripe *stripe = &table->stripes[i];
+
+        pthread_mutex_lock(&stripe->lock);
+        z__hash_table_add_probe_stats(&stripe->table, &stats);
+        size += stripe->table.size;
+        capacity += stripe->table.capacity;
+        pthread_mutex_unlock(&stripe->lock);
+    }
+
+    z__probe_stats_finish(&stats, size, capacity);
+
+    return stats;
+}
+
+void z_hash_table_dump_probe_stats(Z_Hash_Table_Probe_Stats stats, FILE *fp)
+{
+    fprintf(fp, "max probe:  %zu\n", stats.max);
+    fprintf(fp, "mean probe: %.2f\n", stats.mean);
+    fprintf(fp, "mean miss:  %.2f\n", stats.mean_miss);
+
+    for (size_t i = 0; i < Z_HASH_TABLE_PROBE_HISTOGRAM_SIZE; i++) {
+        const char *suffix = i + 1 == Z_HASH_TABLE_PROBE_HISTOGRAM_SIZE ? "+" : "";
+        fprintf(fp, "  %zu%s: %zu\n", i + 1, suffix, stats.histogram[i]);
+    }
+}
+
 bool z_str_equal(const void *a, const void *b)
 {
     return strcmp(a, b) == 0;
 }
 
-size_t z_str_hash(const void *s)
+static inline uint64_t z__hash_mix(uint64_t a, uint64_t b)
+{
+    z__u128 product = (z__u128)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static inline uint64_t z__hash_read_64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t z__hash_read_32(const uint8_t *p)
 {
-    size_t hash = 5381;
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static const uint64_t z__hash_secret[4] = {
+    0x2d358dccaa6c78a5, 0x8bb84b93962eacc9, 0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47,
+};
+
+static inline uint64_t z__hash_seed_mix(uint64_t seed)
+{
+    return seed ^ z__hash_mix(seed ^ z__hash_secret[0], z__hash_secret[1]);
+}
+
+// wyhash: 16 bytes per multiply, 48 per round once the input is long enough
+// to keep three independent lanes busy
+static inline uint64_t z__hash_bytes(const void *data, size_t length, uint64_t seed)
+{
+    const uint64_t *secret = z__hash_secret;
+    const uint8_t *p = data;
+    uint64_t a;
+    uint64_t b;
+
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t middle = (length >> 3) << 2;
+            a = (z__hash_read_32(p) << 32) | z__hash_read_32(p + middle);
+            b = (z__hash_read_32(p + length - 4) << 32) | z__hash_read_32(p + length - 4 - middle);
+        } else if (length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t i = length;
+
+        if (i > 48) {
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+
+            do {
+                seed = z__hash_mix(z__hash_read_64(p) ^ secret[1], z__hash_read_64(p + 8) ^ seed);
+                seed1 = z__hash_mix(z__hash_read_64(p + 16) ^ secret[2], z__hash_read_64(p + 24) ^ seed1);
+                seed2 = z__hash_mix(z__hash_read_64(p + 32) ^ secret[3], z__hash_read_64(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (i > 16) {
+            seed = z__hash_mix(z__hash_read_64(p) ^ secret[1], z__hash_read_64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
 
-    for (const char *curr = s; *curr != '\0'; curr++) {
-        hash = ((hash << 5) + hash) + (size_t)*curr;
+        a = z__hash_read_64(p + i - 16);
+        b = z__hash_read_64(p + i - 8);
     }
 
-    return hash;
+    z__u128 product = (z__u128)(a ^ secret[1]) * (b ^ seed);
+    a = (uint64_t)product;
+    b = (uint64_t)(product >> 64);
+
+    return z__hash_mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+void z_hash_set_seed(uint64_t seed)
+{
+    z__hash_seed_raw = seed;
+    z__hash_seed = z__hash_seed_mix(seed);
+}
+
+uint64_t z_hash_get_seed(void)
+{
+    return z__hash_seed_raw;
+}
+
+size_t z_hash_bytes(const void *data, size_t length)
+{
+    return (size_t)z__hash_bytes(data, length, z__hash_seed);
+}
+
+uint64_t z_hash_bytes_seeded(const void *data, size_t length, uint64_t seed)
+{
+    return z__hash_bytes(data, length, z__hash_seed_mix(seed));
+}
+
+size_t z_str_hash(const void *s)
+{
+    return z_hash_bytes(s, strlen(s));
 }
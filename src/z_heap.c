@@ -1,28 +1,162 @@
 #include <internal/z_math.h>
+#include <assert.h>
+#include <malloc.h>
+#include <pthread.h>
 #include <stdbool.h>
-#include <z_hash_table.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <z_error.h>
+#include <z_heap.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS 0x20
+#endif
+
+#ifndef MREMAP_MAYMOVE
+#define MREMAP_MAYMOVE 1
+#endif
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
 
 #define Z_PTR_TABLE_MIN_CAPACITY 16
 #define Z_PTR_TABLE_MAX_LOAD_FACTOR 0.7
-#define Z_PTR_TABLE_TOMBSTONE ((uintptr_t)1)
 #define Z_PTR_TABLE_EMPTY ((uintptr_t)0)
 
+#define Z_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#define Z_ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+#define Z_ARENA_ALIGNMENT _Alignof(max_align_t)
+
+struct Z_Arena_Chunk {
+    Z_Arena_Chunk *next;
+    size_t capacity;
+    size_t used;
+    _Alignas(max_align_t) unsigned char data[];
+};
+
+typedef struct {
+    _Alignas(max_align_t) size_t size;
+} Z_Arena_Header;
+
+typedef struct {
+    _Alignas(max_align_t) size_t mapped;
+    size_t size;
+} Z_Large_Header;
+
+struct Z_Pool_Slab {
+    Z_Pool_Slab *next;
+    size_t size_class;
+    size_t used;
+};
+
+struct Z_Pool_Block {
+    Z_Pool_Block *next;
+};
+
+struct Z_Heap_Call_Site {
+    const char *file;
+    int line;
+    size_t alloc_count;
+    size_t realloc_count;
+    size_t bytes;
+};
+
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    Z_Ptr_Table table;
+} Z_Heap_Shard;
+
+// the global lock only guards stats and call sites, allocations contend
+// on the shard owning the pointer
+struct Z_Heap_Shards {
+    pthread_mutex_t lock;
+    Z_Heap_Shard shards[Z_HEAP_SHARD_COUNT];
+};
+
+#define Z_POOL_SLAB_HEADER_SIZE z__align_up_size_t(sizeof(Z_Pool_Slab), _Alignof(max_align_t))
+
+void *mremap(void *old_address, size_t old_size, size_t new_size, int flags, ...);
+int madvise(void *addr, size_t length, int advice);
 void z__ptr_table_insert_no_check(Z_Ptr_Table *table, uintptr_t ptr);
 static inline size_t z__ptr_table_fast_mod(size_t value, size_t mod);
 static inline uintptr_t z__ptr_table_hash(uintptr_t ptr);
 void z__ptr_table_resize(Z_Ptr_Table *table, size_t new_capacity);
+void z__ptr_table_shift_back(Z_Ptr_Table *table, size_t hole);
 void z_ptr_table_insert(Z_Ptr_Table *table, uintptr_t ptr);
 bool z_ptr_table_delete(Z_Ptr_Table *table, uintptr_t ptr);
 void z_ptr_table_free(Z_Ptr_Table *table);
 void z_ptr_table_reset(Z_Ptr_Table *table);
+void z__ptr_table_clear(Z_Ptr_Table *table);
+bool z_ptr_table_contains(const Z_Ptr_Table *table, uintptr_t ptr);
+void *z__table_malloc(Z_Ptr_Table *table, size_t size);
+void *z__table_calloc(Z_Ptr_Table *table, size_t size);
+void *z__table_realloc(Z_Ptr_Table *table, void *ptr, size_t new_size);
+void z__table_free(Z_Ptr_Table *table, void *ptr);
+Z_Arena_Chunk *z__arena_chunk_new(size_t capacity);
+Z_Arena_Chunk *z__arena_chunk_for(Z_Arena *arena, size_t needed);
+void *z__arena_malloc(Z_Arena *arena, size_t size);
+void *z__arena_realloc(Z_Arena *arena, void *ptr, size_t new_size);
+void z__arena_free(Z_Arena *arena, void *ptr);
+bool z__arena_is_before_mark(const Z_Arena *arena, const void *ptr);
+void z__arena_free_all(Z_Arena *arena);
+void z__arena_reset(Z_Arena *arena);
+size_t z__pool_class_index(size_t size);
+size_t z__pool_class_size(size_t class_index);
+Z_Pool_Slab *z__pool_slab_of(void *ptr);
+Z_Pool_Slab *z__pool_slab_new(Z_Pool *pool, size_t class_index);
+void *z__pool_malloc(Z_Heap *heap, size_t size);
+void *z__pool_realloc(Z_Heap *heap, void *ptr, size_t new_size);
+void z__pool_free_block(Z_Pool *pool, void *ptr);
+void z__pool_free(Z_Heap *heap, void *ptr);
+void z__pool_free_all(Z_Pool *pool);
+void z__pool_reset(Z_Pool *pool);
+size_t z__large_mapped_size(size_t size);
+void z__large_advise(const Z_Heap *heap, void *base, size_t mapped);
+void *z__large_malloc(Z_Heap *heap, size_t size);
+void *z__large_realloc(Z_Heap *heap, void *ptr, size_t new_size);
+void z__large_unmap(void *ptr);
+void z__large_free_all(Z_Ptr_Table *large);
+void *z__heap_malloc(Z_Heap *heap, size_t size);
+void *z__heap_realloc(Z_Heap *heap, void *ptr, size_t new_size);
+void z__heap_free(Z_Heap *heap, void *ptr);
+bool z__heap_is_arena_table(const Z_Heap *heap, void *ptr);
+size_t z__heap_block_size(const Z_Heap *heap, void *ptr);
+void z__heap_stats_add(Z_Heap *heap, size_t size);
+void z__heap_stats_remove(Z_Heap *heap, size_t size);
+Z_Heap_Call_Site *z__call_sites_get(Z_Heap_Call_Sites *sites, const char *file, int line);
+void z__call_sites_resize(Z_Heap_Call_Sites *sites, size_t new_capacity);
+int z__call_site_compare(const void *a, const void *b);
+void z__heap_log_push(Z_Heap *heap, void *ptr);
+void z__heap_on_alloc(Z_Heap *heap, void *ptr, size_t size, const char *file, int line);
+void z__heap_release(Z_Heap *heap, void *ptr);
+void z__heap_lock(Z_Heap *heap);
+void z__heap_unlock(Z_Heap *heap);
+Z_Heap_Shard *z__shard_of(Z_Heap_Shards *shards, uintptr_t ptr);
+void *z__shards_malloc(Z_Heap_Shards *shards, void *ptr);
+void *z__shards_realloc(Z_Heap_Shards *shards, void *ptr, size_t new_size);
+void z__shards_free(Z_Heap_Shards *shards, void *ptr);
+void z__shards_free_all(Z_Heap_Shards *shards);
+void z__shards_reset(Z_Heap_Shards *shards);
+void z__thread_heap_destroy(void *heap);
+void z__thread_heap_exit(void);
+void z__thread_heap_key_create(void);
 
 static inline size_t z__ptr_table_fast_mod(size_t value, size_t mod)
 {
     return value & (mod - 1);
 }
 
+// malloc pointers share their low alignment bits, mix them so every bucket
+// of the power of two table gets used
 static inline uintptr_t z__ptr_table_hash(uintptr_t ptr)
 {
+    ptr ^= ptr >> 33;
+    ptr *= 0xff51afd7ed558ccd;
+    ptr ^= ptr >> 33;
     return ptr;
 }
 
@@ -39,15 +173,12 @@ void z__ptr_table_insert_no_check(Z_Ptr_Table *table, uintptr_t ptr)
 {
     size_t i = z__ptr_table_fast_mod(z__ptr_table_hash(ptr), table->capacity);
 
-    while (table->ptr[i] > 1) {
+    while (table->ptr[i] != Z_PTR_TABLE_EMPTY) {
         i = z__ptr_table_fast_mod(i + 1, table->capacity);
     }
 
-    if (table->ptr[i] == Z_PTR_TABLE_EMPTY) {
-        table->occupied++;
-    }
-
     table->ptr[i] = ptr;
+    table->occupied++;
 }
 
 void z__ptr_table_resize(Z_Ptr_Table *table, size_t new_capacity)
@@ -59,7 +190,7 @@ void z__ptr_table_resize(Z_Ptr_Table *table, size_t new_capacity)
     };
 
     for (size_t i = 0; i < table->capacity; i++) {
-        if (table->ptr[i] > 1) {
+        if (table->ptr[i] != Z_PTR_TABLE_EMPTY) {
             z__ptr_table_insert_no_check(&new, table->ptr[i]);
         }
     }
@@ -68,8 +199,33 @@ void z__ptr_table_resize(Z_Ptr_Table *table, size_t new_capacity)
     *table = new;
 }
 
+// Backward shift deletion: entries after the hole that may live in it are
+// pulled back, so the table never needs tombstones.
+void z__ptr_table_shift_back(Z_Ptr_Table *table, size_t hole)
+{
+    size_t mask = table->capacity - 1;
+    size_t i = (hole + 1) & mask;
+
+    while (table->ptr[i] != Z_PTR_TABLE_EMPTY) {
+        size_t home = z__ptr_table_fast_mod(z__ptr_table_hash(table->ptr[i]), table->capacity);
+
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table->ptr[hole] = table->ptr[i];
+            hole = i;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    table->ptr[hole] = Z_PTR_TABLE_EMPTY;
+}
+
 void z_ptr_table_insert(Z_Ptr_Table *table, uintptr_t ptr)
 {
+    if (ptr == Z_PTR_TABLE_EMPTY) {
+        return;
+    }
+
     if (z__ptr_table_load_factor(table) >= Z_PTR_TABLE_MAX_LOAD_FACTOR) {
         size_t new_capacity = z__max_size_t(Z_PTR_TABLE_MIN_CAPACITY, table->capacity * 2);
         z__ptr_table_resize(table, new_capacity);
@@ -80,11 +236,36 @@ void z_ptr_table_insert(Z_Ptr_Table *table, uintptr_t ptr)
 
 bool z_ptr_table_delete(Z_Ptr_Table *table, uintptr_t ptr)
 {
+    if (table->capacity == 0) {
+        return false;
+    }
+
+    size_t i = z__ptr_table_fast_mod(z__ptr_table_hash(ptr), table->capacity);
+
+    while (table->ptr[i] != ptr) {
+        if (table->ptr[i] == Z_PTR_TABLE_EMPTY) {
+            return false;
+        }
+
+        i = z__ptr_table_fast_mod(i + 1, table->capacity);
+    }
+
+    z__ptr_table_shift_back(table, i);
+    table->occupied--;
+
+    return true;
+}
+
+bool z_ptr_table_contains(const Z_Ptr_Table *table, uintptr_t ptr)
+{
+    if (table->capacity == 0) {
+        return false;
+    }
+
     size_t i = z__ptr_table_fast_mod(z__ptr_table_hash(ptr), table->capacity);
 
     while (table->ptr[i] != Z_PTR_TABLE_EMPTY) {
         if (table->ptr[i] == ptr) {
-            table->ptr[i] = Z_PTR_TABLE_TOMBSTONE;
             return true;
         }
 
@@ -97,18 +278,25 @@ bool z_ptr_table_delete(Z_Ptr_Table *table, uintptr_t ptr)
 void z_ptr_table_free(Z_Ptr_Table *table)
 {
     for (size_t i = 0; i < table->capacity; i++) {
-        if (table->ptr[i] > 1) {
+        if (table->ptr[i] != Z_PTR_TABLE_EMPTY) {
             free((void*)table->ptr[i]);
         }
     }
 
     free(table->ptr);
+    table->ptr = NULL;
+    table->occupied = 0;
+    table->capacity = 0;
 }
 
 void z_ptr_table_reset(Z_Ptr_Table *table)
 {
+    if (table->capacity == 0) {
+        return;
+    }
+
     for (size_t i = 0; i < table->capacity; i++) {
-        if (table->ptr[i] > 1) {
+        if (table->ptr[i] != Z_PTR_TABLE_EMPTY) {
             free((void*)table->ptr[i]);
         }
     }
@@ -117,51 +305,1165 @@ void z_ptr_table_reset(Z_Ptr_Table *table)
     table->occupied = 0;
 }
 
-void *z_heap_malloc(Z_Heap *heap, size_t size)
+void *z__table_malloc(Z_Ptr_Table *table, size_t size)
 {
     void *ptr = malloc(size);
-    z_ptr_table_insert(heap, (uintptr_t)ptr);
+    z_ptr_table_insert(table, (uintptr_t)ptr);
     return ptr;
 }
 
-void *z_heap_calloc(Z_Heap *heap, size_t size)
+void *z__table_calloc(Z_Ptr_Table *table, size_t size)
 {
     void *ptr = calloc(1, size);
-    z_ptr_table_insert(heap, (uintptr_t)ptr);
+    z_ptr_table_insert(table, (uintptr_t)ptr);
     return ptr;
 }
 
-void *z_heap_realloc(Z_Heap *heap, void *ptr, size_t new_size)
+void *z__table_realloc(Z_Ptr_Table *table, void *ptr, size_t new_size)
 {
+    uintptr_t old_ptr = (uintptr_t)ptr;
     void *new_ptr = realloc(ptr, new_size);
 
-    if (ptr != NULL) {
-        z_ptr_table_delete(heap, (uintptr_t)ptr);
+    if (old_ptr != (uintptr_t)new_ptr) {
+        if (old_ptr != 0) {
+            z_ptr_table_delete(table, old_ptr);
+        }
+
+        z_ptr_table_insert(table, (uintptr_t)new_ptr);
+    }
+
+    return new_ptr;
+}
+
+void z__table_free(Z_Ptr_Table *table, void *ptr)
+{
+    z_ptr_table_delete(table, (uintptr_t)ptr);
+    free(ptr);
+}
+
+void z__ptr_table_clear(Z_Ptr_Table *table)
+{
+    if (table->capacity == 0) {
+        return;
+    }
+
+    memset(table->ptr, 0, sizeof(uintptr_t) * table->capacity);
+    table->occupied = 0;
+}
+
+Z_Arena_Chunk *z__arena_chunk_new(size_t capacity)
+{
+    Z_Arena_Chunk *chunk = malloc(sizeof(Z_Arena_Chunk) + capacity);
+
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    return chunk;
+}
+
+Z_Arena_Chunk *z__arena_chunk_for(Z_Arena *arena, size_t needed)
+{
+    Z_Arena_Chunk *chunk = arena->current;
+
+    if (chunk != NULL && chunk->capacity - chunk->used >= needed) {
+        return chunk;
+    }
+
+    // chunks left over from a reset are reused before allocating new ones
+    if (chunk != NULL && chunk->next != NULL && chunk->next->capacity >= needed) {
+        arena->current = chunk->next;
+        arena->current->used = 0;
+        return arena->current;
+    }
+
+    size_t chunk_size = arena->chunk_size == 0 ? Z_ARENA_DEFAULT_CHUNK_SIZE : arena->chunk_size;
+    Z_Arena_Chunk *new_chunk = z__arena_chunk_new(z__max_size_t(chunk_size, needed));
+
+    if (new_chunk == NULL) {
+        return NULL;
+    }
+
+    if (chunk == NULL) {
+        arena->first = new_chunk;
+    } else {
+        new_chunk->next = chunk->next;
+        chunk->next = new_chunk;
+    }
+
+    arena->current = new_chunk;
+    return new_chunk;
+}
+
+void *z__arena_malloc(Z_Arena *arena, size_t size)
+{
+    size_t needed = sizeof(Z_Arena_Header) + z__align_up_size_t(size, Z_ARENA_ALIGNMENT);
+    Z_Arena_Chunk *chunk = z__arena_chunk_for(arena, needed);
+
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    Z_Arena_Header *header = (void *)(chunk->data + chunk->used);
+    header->size = size;
+    chunk->used += needed;
+    arena->last = header + 1;
+
+    return arena->last;
+}
+
+void *z__arena_realloc(Z_Arena *arena, void *ptr, size_t new_size)
+{
+    if (ptr == NULL) {
+        return z__arena_malloc(arena, new_size);
+    }
+
+    Z_Arena_Header *header = (Z_Arena_Header *)ptr - 1;
+
+    if (ptr == arena->last) {
+        Z_Arena_Chunk *chunk = arena->current;
+        size_t start = (size_t)((unsigned char *)header - chunk->data);
+        size_t needed = sizeof(Z_Arena_Header) + z__align_up_size_t(new_size, Z_ARENA_ALIGNMENT);
+
+        if (chunk->capacity - start >= needed) {
+            chunk->used = start + needed;
+            header->size = new_size;
+            return ptr;
+        }
     }
 
-    if (ptr != new_ptr) {
-        z_ptr_table_insert(heap, (uintptr_t)new_ptr);
+    void *new_ptr = z__arena_malloc(arena, new_size);
+
+    if (new_ptr == NULL) {
+        return NULL;
     }
 
+    memcpy(new_ptr, ptr, z__min_size_t(header->size, new_size));
+
     return new_ptr;
 }
 
-void z_heap_free(Z_Heap *heap, void *ptr)
+// Whether ptr was allocated before the innermost mark, chunks are linked in
+// the order the bump pointer goes through them. A mark taken on an empty
+// arena has no chunk and nothing before it.
+bool z__arena_is_before_mark(const Z_Arena *arena, const void *ptr)
+{
+    const unsigned char *p = ptr;
+
+    if (arena->mark_chunk == NULL) {
+        return false;
+    }
+
+    for (const Z_Arena_Chunk *chunk = arena->first; chunk != NULL; chunk = chunk->next) {
+        if (chunk == arena->mark_chunk) {
+            return p >= chunk->data && p < chunk->data + arena->mark_used;
+        }
+
+        if (p >= chunk->data && p < chunk->data + chunk->capacity) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void z__arena_free(Z_Arena *arena, void *ptr)
+{
+    if (ptr == NULL || ptr != arena->last) {
+        return;
+    }
+
+    Z_Arena_Header *header = (Z_Arena_Header *)ptr - 1;
+    arena->current->used = (size_t)((unsigned char *)header - arena->current->data);
+    arena->last = NULL;
+}
+
+void z__arena_free_all(Z_Arena *arena)
+{
+    Z_Arena_Chunk *chunk = arena->first;
+
+    while (chunk != NULL) {
+        Z_Arena_Chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->last = NULL;
+    arena->mark_chunk = NULL;
+}
+
+void z__arena_reset(Z_Arena *arena)
+{
+    if (arena->first != NULL) {
+        arena->first->used = 0;
+    }
+
+    arena->current = arena->first;
+    arena->last = NULL;
+    arena->mark_chunk = NULL;
+}
+
+size_t z__pool_class_index(size_t size)
+{
+    if (size <= 32) {
+        return size <= 16 ? 0 : 1;
+    }
+
+    // two classes per power of two: 2^p + 2^(p-1) and 2^(p+1)
+    size_t p = z__log2_size_t(size - 1);
+    size_t half_step = ((size_t)1 << p) + ((size_t)1 << (p - 1));
+
+    return 2 * (p - 5) + (size <= half_step ? 2 : 3);
+}
+
+size_t z__pool_class_size(size_t class_index)
+{
+    if (class_index < 2) {
+        return 16 * (class_index + 1);
+    }
+
+    size_t base = (size_t)1 << ((class_index - 2) / 2 + 5);
+
+    return class_index % 2 == 0 ? base + base / 2 : base * 2;
+}
+
+Z_Pool_Slab *z__pool_slab_of(void *ptr)
+{
+    return (void *)((uintptr_t)ptr & ~(uintptr_t)(Z_POOL_SLAB_SIZE - 1));
+}
+
+Z_Pool_Slab *z__pool_slab_new(Z_Pool *pool, size_t class_index)
+{
+    Z_Pool_Slab *slab = pool->spare_slabs;
+
+    if (slab != NULL) {
+        pool->spare_slabs = slab->next;
+    } else {
+        slab = aligned_alloc(Z_POOL_SLAB_SIZE, Z_POOL_SLAB_SIZE);
+
+        if (slab == NULL) {
+            return NULL;
+        }
+    }
+
+    slab->next = pool->slabs;
+    slab->size_class = class_index;
+    slab->used = Z_POOL_SLAB_HEADER_SIZE;
+    pool->slabs = slab;
+
+    return slab;
+}
+
+void *z__pool_malloc(Z_Heap *heap, size_t size)
+{
+    if (size > Z_POOL_MAX_SIZE) {
+        return z__table_malloc(&heap->table, size);
+    }
+
+    Z_Pool *pool = &heap->pool;
+    size_t class_index = z__pool_class_index(size);
+    Z_Pool_Block *block = pool->free_lists[class_index];
+
+    if (block != NULL) {
+        pool->free_lists[class_index] = block->next;
+        return block;
+    }
+
+    size_t block_size = z__pool_class_size(class_index);
+    Z_Pool_Slab *slab = pool->current[class_index];
+
+    if (slab == NULL || Z_POOL_SLAB_SIZE - slab->used < block_size) {
+        slab = z__pool_slab_new(pool, class_index);
+
+        if (slab == NULL) {
+            return NULL;
+        }
+
+        pool->current[class_index] = slab;
+    }
+
+    void *ptr = (unsigned char *)slab + slab->used;
+    slab->used += block_size;
+
+    return ptr;
+}
+
+void *z__pool_realloc(Z_Heap *heap, void *ptr, size_t new_size)
 {
     if (ptr == NULL) {
+        return z__pool_malloc(heap, new_size);
+    }
+
+    // blocks that started out big stay on the malloc path
+    if (z_ptr_table_contains(&heap->table, (uintptr_t)ptr)) {
+        return z__table_realloc(&heap->table, ptr, new_size);
+    }
+
+    size_t old_size = z__pool_class_size(z__pool_slab_of(ptr)->size_class);
+
+    if (new_size <= old_size) {
+        return ptr;
+    }
+
+    void *new_ptr = z__pool_malloc(heap, new_size);
+
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+
+    memcpy(new_ptr, ptr, old_size);
+    z__pool_free_block(&heap->pool, ptr);
+
+    return new_ptr;
+}
+
+void z__pool_free_block(Z_Pool *pool, void *ptr)
+{
+    Z_Pool_Block *block = ptr;
+    size_t class_index = z__pool_slab_of(ptr)->size_class;
+
+    block->next = pool->free_lists[class_index];
+    pool->free_lists[class_index] = block;
+}
+
+void z__pool_free(Z_Heap *heap, void *ptr)
+{
+    if (z_ptr_table_delete(&heap->table, (uintptr_t)ptr)) {
+        free(ptr);
         return;
     }
 
-    free(ptr);
-    z_ptr_table_delete(heap, (uintptr_t)ptr);
+    z__pool_free_block(&heap->pool, ptr);
 }
 
-void z_heap_free_all(Z_Heap *heap)
+void z__pool_free_all(Z_Pool *pool)
 {
-    z_ptr_table_free(heap);
+    z__pool_reset(pool);
+
+    Z_Pool_Slab *slab = pool->spare_slabs;
+
+    while (slab != NULL) {
+        Z_Pool_Slab *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    pool->spare_slabs = NULL;
 }
 
-void z_heap_reset(Z_Heap *heap)
+void z__pool_reset(Z_Pool *pool)
+{
+    while (pool->slabs != NULL) {
+        Z_Pool_Slab *slab = pool->slabs;
+        pool->slabs = slab->next;
+        slab->next = pool->spare_slabs;
+        pool->spare_slabs = slab;
+    }
+
+    memset(pool->free_lists, 0, sizeof(pool->free_lists));
+    memset(pool->current, 0, sizeof(pool->current));
+}
+
+static inline bool z__heap_has_large_path(const Z_Heap *heap)
+{
+    return heap->kind == Z_HEAP_MALLOC || heap->kind == Z_HEAP_POOL;
+}
+
+static inline bool z__heap_is_large(const Z_Heap *heap, void *ptr)
+{
+    return heap->large.occupied > 0 && z_ptr_table_contains(&heap->large, (uintptr_t)ptr);
+}
+
+// blocks of an arena heap that left bump space, see z__heap_realloc
+bool z__heap_is_arena_table(const Z_Heap *heap, void *ptr)
+{
+    return heap->table.occupied > 0 && z_ptr_table_contains(&heap->table, (uintptr_t)ptr);
+}
+
+static inline Z_Large_Header *z__large_header(void *ptr)
+{
+    return (Z_Large_Header *)ptr - 1;
+}
+
+size_t z__large_mapped_size(size_t size)
+{
+    return z__align_up_size_t(sizeof(Z_Large_Header) + size, (size_t)sysconf(_SC_PAGESIZE));
+}
+
+void z__large_advise(const Z_Heap *heap, void *base, size_t mapped)
+{
+    if (heap->huge_pages && mapped >= Z_HUGE_PAGE_SIZE) {
+        madvise(base, mapped, MADV_HUGEPAGE);
+    }
+}
+
+void *z__large_malloc(Z_Heap *heap, size_t size)
+{
+    size_t mapped = z__large_mapped_size(size);
+    void *base = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    z__large_advise(heap, base, mapped);
+
+    Z_Large_Header *header = base;
+    header->mapped = mapped;
+    header->size = size;
+    z_ptr_table_insert(&heap->large, (uintptr_t)(header + 1));
+
+    return header + 1;
+}
+
+// mremap moves the pages instead of copying them, so growing a big buffer
+// costs page table updates only
+void *z__large_realloc(Z_Heap *heap, void *ptr, size_t new_size)
+{
+    Z_Large_Header *header = z__large_header(ptr);
+    size_t mapped = z__large_mapped_size(new_size);
+
+    if (mapped != header->mapped) {
+        void *base = mremap(header, header->mapped, mapped, MREMAP_MAYMOVE);
+
+        if (base == MAP_FAILED) {
+            return NULL;
+        }
+
+        z_ptr_table_delete(&heap->large, (uintptr_t)ptr);
+        z__large_advise(heap, base, mapped);
+
+        header = base;
+        header->mapped = mapped;
+        z_ptr_table_insert(&heap->large, (uintptr_t)(header + 1));
+    }
+
+    header->size = new_size;
+
+    return header + 1;
+}
+
+void z__large_unmap(void *ptr)
+{
+    Z_Large_Header *header = z__large_header(ptr);
+    munmap(header, header->mapped);
+}
+
+void z__large_free_all(Z_Ptr_Table *large)
+{
+    for (size_t i = 0; i < large->capacity; i++) {
+        if (large->ptr[i] != Z_PTR_TABLE_EMPTY) {
+            z__large_unmap((void *)large->ptr[i]);
+        }
+    }
+
+    z__ptr_table_clear(large);
+}
+
+Z_Heap_Shard *z__shard_of(Z_Heap_Shards *shards, uintptr_t ptr)
 {
-    z_ptr_table_reset(heap);
+    size_t i = (size_t)(((ptr >> 4) * 0x9e3779b97f4a7c15) >> 32) % Z_HEAP_SHARD_COUNT;
+    return &shards->shards[i];
+}
+
+void *z__shards_malloc(Z_Heap_Shards *shards, void *ptr)
+{
+    Z_Heap_Shard *shard = z__shard_of(shards, (uintptr_t)ptr);
+
+    pthread_mutex_lock(&shard->lock);
+    z_ptr_table_insert(&shard->table, (uintptr_t)ptr);
+    pthread_mutex_unlock(&shard->lock);
+
+    return ptr;
+}
+
+void *z__shards_realloc(Z_Heap_Shards *shards, void *ptr, size_t new_size)
+{
+    uintptr_t old_ptr = (uintptr_t)ptr;
+    void *new_ptr = realloc(ptr, new_size);
+
+    if (old_ptr == (uintptr_t)new_ptr) {
+        return new_ptr;
+    }
+
+    if (old_ptr != 0) {
+        Z_Heap_Shard *shard = z__shard_of(shards, old_ptr);
+
+        pthread_mutex_lock(&shard->lock);
+        z_ptr_table_delete(&shard->table, old_ptr);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return z__shards_malloc(shards, new_ptr);
+}
+
+void z__shards_free(Z_Heap_Shards *shards, void *ptr)
+{
+    Z_Heap_Shard *shard = z__shard_of(shards, (uintptr_t)ptr);
+
+    pthread_mutex_lock(&shard->lock);
+    z_ptr_table_delete(&shard->table, (uintptr_t)ptr);
+    pthread_mutex_unlock(&shard->lock);
+
+    free(ptr);
+}
+
+void z__shards_free_all(Z_Heap_Shards *shards)
+{
+    if (shards == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < Z_HEAP_SHARD_COUNT; i++) {
+        z_ptr_table_free(&shards->shards[i].table);
+        pthread_mutex_destroy(&shards->shards[i].lock);
+    }
+
+    pthread_mutex_destroy(&shards->lock);
+    free(shards);
+}
+
+void z__shards_reset(Z_Heap_Shards *shards)
+{
+    if (shards == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < Z_HEAP_SHARD_COUNT; i++) {
+        pthread_mutex_lock(&shards->shards[i].lock);
+        z_ptr_table_reset(&shards->shards[i].table);
+        pthread_mutex_unlock(&shards->shards[i].lock);
+    }
+}
+
+void z__heap_lock(Z_Heap *heap)
+{
+    if (heap->kind == Z_HEAP_CONCURRENT) {
+        pthread_mutex_lock(&heap->shards->lock);
+    }
+}
+
+void z__heap_unlock(Z_Heap *heap)
+{
+    if (heap->kind == Z_HEAP_CONCURRENT) {
+        pthread_mutex_unlock(&heap->shards->lock);
+    }
+}
+
+static inline size_t z__call_site_hash(const char *file, int line)
+{
+    return ((uintptr_t)file ^ (size_t)line) * 0x9e3779b97f4a7c15;
+}
+
+Z_Heap_Call_Site *z__call_sites_get(Z_Heap_Call_Sites *sites, const char *file, int line)
+{
+    if (sites->capacity == 0 || (float)sites->length / (float)sites->capacity >= Z_PTR_TABLE_MAX_LOAD_FACTOR) {
+        z__call_sites_resize(sites, z__max_size_t(Z_PTR_TABLE_MIN_CAPACITY, sites->capacity * 2));
+    }
+
+    size_t i = z__ptr_table_fast_mod(z__call_site_hash(file, line), sites->capacity);
+
+    while (sites->ptr[i].alloc_count + sites->ptr[i].realloc_count > 0) {
+        if (sites->ptr[i].file == file && sites->ptr[i].line == line) {
+            return &sites->ptr[i];
+        }
+
+        i = z__ptr_table_fast_mod(i + 1, sites->capacity);
+    }
+
+    sites->ptr[i].file = file;
+    sites->ptr[i].line = line;
+    sites->length++;
+
+    return &sites->ptr[i];
+}
+
+void z__call_sites_resize(Z_Heap_Call_Sites *sites, size_t new_capacity)
+{
+    Z_Heap_Call_Sites new = {
+        .ptr = calloc(new_capacity, sizeof(Z_Heap_Call_Site)),
+        .length = sites->length,
+        .capacity = new_capacity,
+    };
+
+    for (size_t i = 0; i < sites->capacity; i++) {
+        Z_Heap_Call_Site *site = &sites->ptr[i];
+
+        if (site->alloc_count + site->realloc_count > 0) {
+            size_t j = z__ptr_table_fast_mod(z__call_site_hash(site->file, site->line), new_capacity);
+
+            while (new.ptr[j].alloc_count + new.ptr[j].realloc_count > 0) {
+                j = z__ptr_table_fast_mod(j + 1, new_capacity);
+            }
+
+            new.ptr[j] = *site;
+        }
+    }
+
+    free(sites->ptr);
+    *sites = new;
+}
+
+int z__call_site_compare(const void *a, const void *b)
+{
+    const Z_Heap_Call_Site *site_a = a;
+    const Z_Heap_Call_Site *site_b = b;
+
+    return (site_a->bytes < site_b->bytes) - (site_a->bytes > site_b->bytes);
+}
+
+size_t z__heap_block_size(const Z_Heap *heap, void *ptr)
+{
+    if (ptr == NULL) {
+        return 0;
+    }
+
+    if (z__heap_is_large(heap, ptr)) {
+        return z__large_header(ptr)->size;
+    }
+
+    switch (heap->kind) {
+        case Z_HEAP_ARENA:
+            if (!z__heap_is_arena_table(heap, ptr)) {
+                return ((Z_Arena_Header *)ptr - 1)->size;
+            }
+            break;
+
+        case Z_HEAP_POOL:
+            if (!z_ptr_table_contains(&heap->table, (uintptr_t)ptr)) {
+                return z__pool_class_size(z__pool_slab_of(ptr)->size_class);
+            }
+            break;
+
+        case Z_HEAP_CONCURRENT:
+        case Z_HEAP_MALLOC:
+            break;
+    }
+
+    return malloc_usable_size(ptr);
+}
+
+void z__heap_stats_add(Z_Heap *heap, size_t size)
+{
+    heap->stats.live_bytes += size;
+    heap->stats.peak_bytes = z__max_size_t(heap->stats.peak_bytes, heap->stats.live_bytes);
+}
+
+void z__heap_stats_remove(Z_Heap *heap, size_t size)
+{
+    heap->stats.live_bytes -= z__min_size_t(size, heap->stats.live_bytes);
+}
+
+void *z__heap_malloc(Z_Heap *heap, size_t size)
+{
+    if (size >= Z_HEAP_LARGE_THRESHOLD && z__heap_has_large_path(heap)) {
+        return z__large_malloc(heap, size);
+    }
+
+    switch (heap->kind) {
+        case Z_HEAP_ARENA:
+            return z__arena_malloc(&heap->arena, size);
+
+        case Z_HEAP_POOL:
+            return z__pool_malloc(heap, size);
+
+        case Z_HEAP_CONCURRENT:
+            return z__shards_malloc(heap->shards, malloc(size));
+
+        case Z_HEAP_MALLOC:
+            break;
+    }
+
+    return z__table_malloc(&heap->table, size);
+}
+
+void *z__heap_realloc(Z_Heap *heap, void *ptr, size_t new_size)
+{
+    if (z__heap_has_large_path(heap) && ptr != NULL) {
+        if (z__heap_is_large(heap, ptr)) {
+            return z__large_realloc(heap, ptr, new_size);
+        }
+
+        if (new_size >= Z_HEAP_LARGE_THRESHOLD) {
+            void *new_ptr = z__large_malloc(heap, new_size);
+
+            if (new_ptr == NULL) {
+                return NULL;
+            }
+
+            memcpy(new_ptr, ptr, z__min_size_t(z__heap_block_size(heap, ptr), new_size));
+            z__heap_free(heap, ptr);
+            return new_ptr;
+        }
+    }
+
+    switch (heap->kind) {
+        case Z_HEAP_ARENA:
+            if (ptr != NULL && z__heap_is_arena_table(heap, ptr)) {
+                break;
+            }
+
+            // moving a block older than the mark into bump space would hand
+            // it to the next rewind, so it leaves the arena instead
+            if (ptr != NULL && heap->mark_depth > 0 && z__arena_is_before_mark(&heap->arena, ptr)) {
+                void *new_ptr = z__table_malloc(&heap->table, new_size);
+
+                if (new_ptr != NULL) {
+                    memcpy(new_ptr, ptr, z__min_size_t(((Z_Arena_Header *)ptr - 1)->size, new_size));
+                }
+
+                return new_ptr;
+            }
+
+            return z__arena_realloc(&heap->arena, ptr, new_size);
+
+        case Z_HEAP_POOL:
+            return z__pool_realloc(heap, ptr, new_size);
+
+        case Z_HEAP_CONCURRENT:
+            return z__shards_realloc(heap->shards, ptr, new_size);
+
+        case Z_HEAP_MALLOC:
+            break;
+    }
+
+    return z__table_realloc(&heap->table, ptr, new_size);
+}
+
+void z__heap_free(Z_Heap *heap, void *ptr)
+{
+    if (heap->large.occupied > 0 && z_ptr_table_delete(&heap->large, (uintptr_t)ptr)) {
+        z__large_unmap(ptr);
+        return;
+    }
+
+    switch (heap->kind) {
+        case Z_HEAP_ARENA:
+            if (!z__heap_is_arena_table(heap, ptr)) {
+                z__arena_free(&heap->arena, ptr);
+                return;
+            }
+            break;
+
+        case Z_HEAP_POOL:
+            z__pool_free(heap, ptr);
+            return;
+
+        case Z_HEAP_CONCURRENT:
+            z__shards_free(heap->shards, ptr);
+            return;
+
+        case Z_HEAP_MALLOC:
+            break;
+    }
+
+    z__table_free(&heap->table, ptr);
+}
+
+void z__heap_log_push(Z_Heap *heap, void *ptr)
+{
+    Z_Heap_Log *log = &heap->log;
+
+    if (log->length == log->capacity) {
+        log->capacity = z__max_size_t(Z_PTR_TABLE_MIN_CAPACITY, log->capacity * 2);
+        log->ptr = realloc(log->ptr, sizeof(uintptr_t) * log->capacity);
+    }
+
+    log->ptr[log->length++] = (uintptr_t)ptr;
+    z_ptr_table_insert(&heap->young, (uintptr_t)ptr);
+}
+
+void z__heap_on_alloc(Z_Heap *heap, void *ptr, size_t size, const char *file, int line)
+{
+    if (heap->track_stats) {
+        z__heap_lock(heap);
+        heap->stats.alloc_count++;
+        z__heap_stats_add(heap, z__heap_block_size(heap, ptr));
+
+        if (heap->track_call_sites) {
+            Z_Heap_Call_Site *site = z__call_sites_get(&heap->call_sites, file, line);
+            site->alloc_count++;
+            site->bytes += size;
+        }
+
+        z__heap_unlock(heap);
+    }
+
+    // arenas rewind by moving the bump pointer back, everything else is logged
+    if (heap->mark_depth > 0 && heap->kind != Z_HEAP_ARENA) {
+        z__heap_log_push(heap, ptr);
+    }
+}
+
+void z__heap_release(Z_Heap *heap, void *ptr)
+{
+    if (heap->track_stats) {
+        z__heap_lock(heap);
+        heap->stats.free_count++;
+        z__heap_stats_remove(heap, z__heap_block_size(heap, ptr));
+        z__heap_unlock(heap);
+    }
+
+    z__heap_free(heap, ptr);
+}
+
+Z_Heap z_heap_new(void)
+{
+    Z_Heap heap = {
+        .kind = Z_HEAP_MALLOC,
+    };
+
+    return heap;
+}
+
+Z_Heap z_heap_new_arena(size_t chunk_size)
+{
+    Z_Heap heap = z_heap_new();
+    heap.kind = Z_HEAP_ARENA;
+    heap.arena.chunk_size = chunk_size;
+
+    return heap;
+}
+
+Z_Heap z_heap_new_pool(void)
+{
+    Z_Heap heap = z_heap_new();
+    heap.kind = Z_HEAP_POOL;
+
+    return heap;
+}
+
+Z_Heap z_heap_new_concurrent(void)
+{
+    Z_Heap heap = z_heap_new();
+    heap.kind = Z_HEAP_CONCURRENT;
+    heap.shards = aligned_alloc(_Alignof(Z_Heap_Shards), sizeof(Z_Heap_Shards));
+
+    if (heap.shards == NULL) {
+        z_die("z_heap: out of memory\n");
+    }
+
+    pthread_mutex_init(&heap.shards->lock, NULL);
+
+    for (size_t i = 0; i < Z_HEAP_SHARD_COUNT; i++) {
+        pthread_mutex_init(&heap.shards->shards[i].lock, NULL);
+        heap.shards->shards[i].table = (Z_Ptr_Table){0};
+    }
+
+    return heap;
+}
+
+static pthread_key_t z__thread_heap_key;
+static pthread_once_t z__thread_heap_once = PTHREAD_ONCE_INIT;
+static _Thread_local Z_Heap *z__thread_heap = NULL;
+
+void z__thread_heap_destroy(void *heap)
+{
+    z_heap_free_all(heap);
+    free(heap);
+
+    if (z__thread_heap == heap) {
+        z__thread_heap = NULL;
+    }
+}
+
+// key destructors don't run for the thread that calls exit()
+void z__thread_heap_exit(void)
+{
+    if (z__thread_heap != NULL) {
+        pthread_setspecific(z__thread_heap_key, NULL);
+        z__thread_heap_destroy(z__thread_heap);
+    }
+}
+
+void z__thread_heap_key_create(void)
+{
+    pthread_key_create(&z__thread_heap_key, z__thread_heap_destroy);
+    atexit(z__thread_heap_exit);
+}
+
+Z_Heap *z_heap_thread_local(void)
+{
+    if (z__thread_heap != NULL) {
+        return z__thread_heap;
+    }
+
+    pthread_once(&z__thread_heap_once, z__thread_heap_key_create);
+
+    Z_Heap *heap = malloc(sizeof(Z_Heap));
+
+    if (heap == NULL) {
+        return NULL;
+    }
+
+    *heap = z_heap_new_pool();
+    z__thread_heap = heap;
+    pthread_setspecific(z__thread_heap_key, heap);
+
+    return heap;
+}
+
+// the public names are parenthesized so the Z_HEAP_TRACE macros leave them alone
+void *(z_heap_malloc)(Z_Heap *heap, size_t size)
+{
+    return z_heap_malloc_at(heap, size, NULL, 0);
+}
+
+void *(z_heap_calloc)(Z_Heap *heap, size_t size)
+{
+    return z_heap_calloc_at(heap, size, NULL, 0);
+}
+
+void *(z_heap_realloc)(Z_Heap *heap, void *ptr, size_t new_size)
+{
+    return z_heap_realloc_at(heap, ptr, new_size, NULL, 0);
+}
+
+void *z_heap_malloc_at(Z_Heap *heap, size_t size, const char *file, int line)
+{
+    void *ptr = z__heap_malloc(heap, size);
+    z__heap_on_alloc(heap, ptr, size, file, line);
+    return ptr;
+}
+
+void *z_heap_calloc_at(Z_Heap *heap, size_t size, const char *file, int line)
+{
+    // fresh mappings are already zeroed
+    if (size >= Z_HEAP_LARGE_THRESHOLD && z__heap_has_large_path(heap)) {
+        return z_heap_malloc_at(heap, size, file, line);
+    }
+
+    if (heap->kind != Z_HEAP_MALLOC) {
+        void *ptr = z_heap_malloc_at(heap, size, file, line);
+        return ptr == NULL ? NULL : memset(ptr, 0, size);
+    }
+
+    void *ptr = z__table_calloc(&heap->table, size);
+    z__heap_on_alloc(heap, ptr, size, file, line);
+    return ptr;
+}
+
+void *z_heap_realloc_at(Z_Heap *heap, void *ptr, size_t new_size, const char *file, int line)
+{
+    if (ptr == NULL) {
+        return z_heap_malloc_at(heap, new_size, file, line);
+    }
+
+    size_t old_size = heap->track_stats ? z__heap_block_size(heap, ptr) : 0;
+    bool is_remap = heap->track_stats && z__heap_is_large(heap, ptr);
+    uintptr_t old_ptr = (uintptr_t)ptr;
+    void *new_ptr = z__heap_realloc(heap, ptr, new_size);
+
+    if (heap->track_stats) {
+        z__heap_lock(heap);
+        heap->stats.realloc_count++;
+        z__heap_stats_remove(heap, old_size);
+        z__heap_stats_add(heap, z__heap_block_size(heap, new_ptr));
+
+        if (old_ptr != (uintptr_t)new_ptr && !is_remap) {
+            heap->stats.realloc_copy_bytes += z__min_size_t(old_size, new_size);
+        }
+
+        if (heap->track_call_sites) {
+            Z_Heap_Call_Site *site = z__call_sites_get(&heap->call_sites, file, line);
+            site->realloc_count++;
+            site->bytes += new_size;
+        }
+
+        z__heap_unlock(heap);
+    }
+
+    // a moved block keeps the age of the block it came from
+    if (heap->mark_depth > 0 && new_ptr != NULL && old_ptr != (uintptr_t)new_ptr && z_ptr_table_delete(&heap->young, old_ptr)) {
+        z__heap_log_push(heap, new_ptr);
+    }
+
+    return new_ptr;
+}
+
+void z_heap_free(Z_Heap *heap, void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (heap->mark_depth > 0) {
+        z_ptr_table_delete(&heap->young, (uintptr_t)ptr);
+    }
+
+    z__heap_release(heap, ptr);
+}
+
+void z_heap_free_all(Z_Heap *heap)
+{
+    z__large_free_all(&heap->large);
+    free(heap->large.ptr);
+    heap->large = (Z_Ptr_Table){0};
+    z_ptr_table_free(&heap->table);
+    z__arena_free_all(&heap->arena);
+    z__pool_free_all(&heap->pool);
+    z__shards_free_all(heap->shards);
+    heap->shards = NULL;
+
+    free(heap->call_sites.ptr);
+    heap->call_sites = (Z_Heap_Call_Sites){0};
+    heap->stats.live_bytes = 0;
+
+    free(heap->log.ptr);
+    heap->log = (Z_Heap_Log){0};
+    free(heap->young.ptr);
+    heap->young = (Z_Ptr_Table){0};
+    heap->mark_depth = 0;
+}
+
+void z_heap_reset(Z_Heap *heap)
+{
+    z__large_free_all(&heap->large);
+    z_ptr_table_reset(&heap->table);
+    z__arena_reset(&heap->arena);
+    z__pool_reset(&heap->pool);
+    z__shards_reset(heap->shards);
+
+    heap->stats.live_bytes = 0;
+
+    heap->log.length = 0;
+    z__ptr_table_clear(&heap->young);
+    heap->mark_depth = 0;
+}
+
+Z_Heap_Mark z_heap_mark(Z_Heap *heap)
+{
+    assert(heap->kind != Z_HEAP_CONCURRENT && "marks are not supported on concurrent heaps");
+
+    Z_Heap_Mark mark = {
+        .depth = heap->mark_depth,
+        .log_length = heap->log.length,
+        .live_bytes = heap->stats.live_bytes,
+        .chunk = heap->arena.current,
+        .chunk_used = heap->arena.current == NULL ? 0 : heap->arena.current->used,
+        .previous_chunk = heap->arena.mark_chunk,
+        .previous_used = heap->arena.mark_used,
+    };
+
+    // older blocks must not be grown in place over the marked position
+    heap->arena.last = NULL;
+    heap->arena.mark_chunk = mark.chunk;
+    heap->arena.mark_used = mark.chunk_used;
+    heap->mark_depth++;
+
+    return mark;
+}
+
+void z_heap_rewind(Z_Heap *heap, Z_Heap_Mark mark)
+{
+    assert(mark.depth < heap->mark_depth && "rewinding to a mark that was already released");
+
+    if (heap->kind == Z_HEAP_ARENA) {
+        if (mark.chunk == NULL) {
+            z__arena_reset(&heap->arena);
+        } else {
+            heap->arena.current = mark.chunk;
+            heap->arena.current->used = mark.chunk_used;
+            heap->arena.last = NULL;
+        }
+
+        heap->stats.live_bytes = z__min_size_t(heap->stats.live_bytes, mark.live_bytes);
+    }
+
+    while (heap->log.length > mark.log_length) {
+        uintptr_t ptr = heap->log.ptr[--heap->log.length];
+
+        // entries of blocks that were freed or moved since are stale
+        if (z_ptr_table_delete(&heap->young, ptr)) {
+            z__heap_release(heap, (void *)ptr);
+        }
+    }
+
+    heap->mark_depth = mark.depth;
+    heap->arena.mark_chunk = mark.previous_chunk;
+    heap->arena.mark_used = mark.previous_used;
+}
+
+void z_heap_unmark(Z_Heap *heap, Z_Heap_Mark mark)
+{
+    assert(mark.depth < heap->mark_depth && "releasing a mark that was already released");
+
+    heap->mark_depth = mark.depth;
+    heap->arena.mark_chunk = mark.previous_chunk;
+    heap->arena.mark_used = mark.previous_used;
+
+    if (heap->mark_depth == 0) {
+        heap->log.length = 0;
+        z__ptr_table_clear(&heap->young);
+    }
+}
+
+void z_heap_enable_huge_pages(Z_Heap *heap)
+{
+    heap->huge_pages = true;
+}
+
+void z_heap_enable_stats(Z_Heap *heap)
+{
+    heap->track_stats = true;
+}
+
+void z_heap_enable_call_sites(Z_Heap *heap)
+{
+    heap->track_stats = true;
+    heap->track_call_sites = true;
+}
+
+Z_Heap_Stats z_heap_get_stats(const Z_Heap *heap)
+{
+    return heap->stats;
+}
+
+void z_heap_dump_stats(const Z_Heap *heap, FILE *fp)
+{
+    const Z_Heap_Stats *stats = &heap->stats;
+
+    fprintf(fp, "live bytes:         %zu\n", stats->live_bytes);
+    fprintf(fp, "peak bytes:         %zu\n", stats->peak_bytes);
+    fprintf(fp, "allocations:        %zu\n", stats->alloc_count);
+    fprintf(fp, "frees:              %zu\n", stats->free_count);
+    fprintf(fp, "reallocations:      %zu\n", stats->realloc_count);
+    fprintf(fp, "realloc copy bytes: %zu\n", stats->realloc_copy_bytes);
+
+    const Z_Heap_Call_Sites *sites = &heap->call_sites;
+
+    if (sites->length == 0) {
+        return;
+    }
+
+    Z_Heap_Call_Site *sorted = malloc(sizeof(Z_Heap_Call_Site) * sites->length);
+    size_t length = 0;
+
+    for (size_t i = 0; i < sites->capacity; i++) {
+        if (sites->ptr[i].alloc_count + sites->ptr[i].realloc_count > 0) {
+            sorted[length++] = sites->ptr[i];
+        }
+    }
+
+    qsort(sorted, length, sizeof(Z_Heap_Call_Site), z__call_site_compare);
+    fprintf(fp, "call sites:\n");
+
+    for (size_t i = 0; i < length; i++) {
+        const Z_Heap_Call_Site *site = &sorted[i];
+
+        if (site->file == NULL) {
+            fprintf(fp, "  <untraced>");
+        } else {
+            fprintf(fp, "  %s:%d", site->file, site->line);
+        }
+
+        fprintf(fp, " allocs %zu reallocs %zu bytes %zu\n", site->alloc_count, site->realloc_count, site->bytes);
+    }
+
+    free(sorted);
 }
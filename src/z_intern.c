@@ -0,0 +1,238 @@
+#include <z_intern.h>
+#include <z_error.h>
+#include <pthread.h>
+
+#define Z_INTERNER_ARENA_CHUNK_SIZE (64 * 1024)
+
+// Sits right in front of the characters of an interned string. Lookups use
+// one on the stack pointing at the string being searched for.
+struct Z_Interned {
+    Z_String_View s;
+    size_t hash;
+    uint32_t id;
+};
+
+struct Z_Interner_Stripe {
+    _Alignas(64) pthread_mutex_t lock;
+    Z_Heap heap;
+    Z_Heap strings;
+    Z_Interner interner;
+};
+
+size_t z__interned_entry_hash(const void *entry);
+bool z__interned_entry_equal(const void *a, const void *b);
+const Z_Interned *z__interned_of(const char *s);
+Z_Interned z__interned_query(Z_String_View s);
+const char *z__intern_hashed(Z_Interner *interner, const Z_Interned *query, uint32_t id);
+Z_Interner_Stripe *z__concurrent_interner_stripe_of(const Z_Concurrent_Interner *interner, size_t hash);
+
+size_t z__interned_entry_hash(const void *entry)
+{
+    return ((const Z_Interned *)entry)->hash;
+}
+
+bool z__interned_entry_equal(const void *a, const void *b)
+{
+    const Z_Interned *x = a;
+    const Z_Interned *y = b;
+
+    return x->hash == y->hash && z_sv_equal(x->s, y->s);
+}
+
+const Z_Interned *z__interned_of(const char *s)
+{
+    return (const Z_Interned *)(const void *)s - 1;
+}
+
+Z_Interned z__interned_query(Z_String_View s)
+{
+    Z_Interned query = {
+        .s = s,
+        .hash = z_sv_hash(s),
+        .id = 0,
+    };
+
+    return query;
+}
+
+Z_Interner z_interner_new(Z_Heap *heap, Z_Heap *strings)
+{
+    Z_Interner interner = {
+        .set = z_set_new(heap, z__interned_entry_equal, z__interned_entry_hash),
+        .entries = z_array_new(heap, Z_Interned_Array),
+        .strings = strings,
+    };
+
+    return interner;
+}
+
+const char *z__intern_hashed(Z_Interner *interner, const Z_Interned *query, uint32_t id)
+{
+    const Z_Interned *found = z_set_get(&interner->set, query);
+
+    if (found) {
+        return found->s.ptr;
+    }
+
+    Z_Interned *entry = z_heap_malloc(interner->strings, sizeof(Z_Interned) + query->s.length + 1);
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    char *ptr = (char *)(entry + 1);
+    memcpy(ptr, query->s.ptr, query->s.length);
+    ptr[query->s.length] = '\0';
+
+    entry->s = (Z_String_View){ .ptr = ptr, .length = query->s.length };
+    entry->hash = query->hash;
+    entry->id = id;
+
+    z_set_add(&interner->set, entry);
+    z_array_push(&interner->entries, entry);
+
+    return ptr;
+}
+
+const char *z_intern(Z_Interner *interner, Z_String_View s)
+{
+    Z_Interned query = z__interned_query(s);
+    return z__intern_hashed(interner, &query, (uint32_t)interner->entries.length);
+}
+
+const char *z_interner_find(const Z_Interner *interner, Z_String_View s)
+{
+    Z_Interned query = z__interned_query(s);
+    const Z_Interned *found = z_set_get(&interner->set, &query);
+
+    return found ? found->s.ptr : NULL;
+}
+
+const char *z_interner_get(const Z_Interner *interner, uint32_t id)
+{
+    if (id >= interner->entries.length) {
+        return NULL;
+    }
+
+    return interner->entries.ptr[id]->s.ptr;
+}
+
+size_t z_interner_size(const Z_Interner *interner)
+{
+    return interner->entries.length;
+}
+
+Z_Concurrent_Interner z_concurrent_interner_new(void)
+{
+    Z_Concurrent_Interner interner = {
+        .stripes = aligned_alloc(_Alignof(Z_Interner_Stripe), sizeof(Z_Interner_Stripe) * Z_INTERNER_STRIPE_COUNT),
+    };
+
+    if (interner.stripes == NULL) {
+        z_die("z_concurrent_interner: out of memory\n");
+    }
+
+    for (size_t i = 0; i < Z_INTERNER_STRIPE_COUNT; i++) {
+        Z_Interner_Stripe *stripe = &interner.stripes[i];
+        pthread_mutex_init(&stripe->lock, NULL);
+        stripe->heap = z_heap_new();
+        stripe->strings = z_heap_new_arena(Z_INTERNER_ARENA_CHUNK_SIZE);
+        stripe->interner = z_interner_new(&stripe->heap, &stripe->strings);
+    }
+
+    return interner;
+}
+
+void z_concurrent_interner_free(Z_Concurrent_Interner *interner)
+{
+    for (size_t i = 0; i < Z_INTERNER_STRIPE_COUNT; i++) {
+        z_heap_free_all(&interner->stripes[i].heap);
+        z_heap_free_all(&interner->stripes[i].strings);
+        pthread_mutex_destroy(&interner->stripes[i].lock);
+    }
+
+    free(interner->stripes);
+    interner->stripes = NULL;
+}
+
+// the low bits of the hash pick the slot inside a stripe, so the stripe is
+// picked by the high ones
+Z_Interner_Stripe *z__concurrent_interner_stripe_of(const Z_Concurrent_Interner *interner, size_t hash)
+{
+    return &interner->stripes[hash >> (sizeof(size_t) * 8 - Z_INTERNER_STRIPE_BITS)];
+}
+
+const char *z_concurrent_intern(Z_Concurrent_Interner *interner, Z_String_View s)
+{
+    Z_Interned query = z__interned_query(s);
+    Z_Interner_Stripe *stripe = z__concurrent_interner_stripe_of(interner, query.hash);
+    uint32_t stripe_index = (uint32_t)(stripe - interner->stripes);
+
+    pthread_mutex_lock(&stripe->lock);
+    uint32_t id = (uint32_t)(stripe->interner.entries.length << Z_INTERNER_STRIPE_BITS) | stripe_index;
+    const char *interned = z__intern_hashed(&stripe->interner, &query, id);
+    pthread_mutex_unlock(&stripe->lock);
+
+    return interned;
+}
+
+const char *z_concurrent_interner_find(const Z_Concurrent_Interner *interner, Z_String_View s)
+{
+    Z_Interned query = z__interned_query(s);
+    Z_Interner_Stripe *stripe = z__concurrent_interner_stripe_of(interner, query.hash);
+
+    pthread_mutex_lock(&stripe->lock);
+    const Z_Interned *found = z_set_get(&stripe->interner.set, &query);
+    pthread_mutex_unlock(&stripe->lock);
+
+    return found ? found->s.ptr : NULL;
+}
+
+const char *z_concurrent_interner_get(const Z_Concurrent_Interner *interner, uint32_t id)
+{
+    Z_Interner_Stripe *stripe = &interner->stripes[id & (Z_INTERNER_STRIPE_COUNT - 1)];
+
+    pthread_mutex_lock(&stripe->lock);
+    const char *interned = z_interner_get(&stripe->interner, id >> Z_INTERNER_STRIPE_BITS);
+    pthread_mutex_unlock(&stripe->lock);
+
+    return interned;
+}
+
+size_t z_concurrent_interner_size(const Z_Concurrent_Interner *interner)
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < Z_INTERNER_STRIPE_COUNT; i++) {
+        pthread_mutex_lock(&interner->stripes[i].lock);
+        size += interner->stripes[i].interner.entries.length;
+        pthread_mutex_unlock(&interner->stripes[i].lock);
+    }
+
+    return size;
+}
+
+uint32_t z_interned_id(const char *s)
+{
+    return z__interned_of(s)->id;
+}
+
+size_t z_interned_length(const char *s)
+{
+    return z__interned_of(s)->s.length;
+}
+
+Z_String_View z_interned_sv(const char *s)
+{
+    return z__interned_of(s)->s;
+}
+
+size_t z_interned_hash(const void *s)
+{
+    return z__interned_of(s)->hash;
+}
+
+bool z_interned_equal(const void *a, const void *b)
+{
+    return a == b;
+}
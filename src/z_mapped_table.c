@@ -0,0 +1,231 @@
+#include <z_mapped_table.h>
+#include <stdio.h>
+#include <internal/z_group.h>
+#include <internal/z_math.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define Z_MAPPED_TABLE_MAGIC "ZMAPTBL1"
+#define Z_MAPPED_TABLE_BYTE_ORDER 0x01020304
+
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t reserved;
+    uint64_t seed;
+    uint64_t size;
+    uint64_t capacity;
+    uint64_t slots_offset;
+    uint64_t strings_offset;
+    uint64_t file_length;
+} Z_Mapped_Table_Header;
+
+// the value follows its key in the strings section, both nul terminated
+typedef struct {
+    uint64_t key_offset;
+    uint32_t key_length;
+    uint32_t value_length;
+} Z_Mapped_Table_Slot;
+
+size_t z__mapped_table_hash(const char *key, size_t length, uint64_t seed);
+bool z__mapped_table_write(FILE *fp, const void *data, size_t length);
+
+size_t z__mapped_table_hash(const char *key, size_t length, uint64_t seed)
+{
+    return z__group_mix((size_t)z_hash_bytes_seeded(key, length, seed));
+}
+
+bool z__mapped_table_write(FILE *fp, const void *data, size_t length)
+{
+    return fwrite(data, 1, length, fp) == length;
+}
+
+bool z_mapped_table_save(const Z_Hash_Table *table, const char *pathname)
+{
+    Z_Heap_Auto heap = {0};
+    size_t capacity = z__max_size_t(Z_HASH_TABLE_MIN_CAPACITY, z__hash_table_capacity_for(table->size));
+    size_t slots_offset = z__align_up_size_t(sizeof(Z_Mapped_Table_Header) + capacity + Z_GROUP_WIDTH, 8);
+    size_t strings_offset = slots_offset + sizeof(Z_Mapped_Table_Slot) * capacity;
+
+    uint8_t *ctrl = z_heap_malloc(&heap, capacity + Z_GROUP_WIDTH);
+    Z_Mapped_Table_Slot *slots = z_heap_calloc(&heap, sizeof(Z_Mapped_Table_Slot) * capacity);
+    memset(ctrl, Z_CTRL_EMPTY, capacity + Z_GROUP_WIDTH);
+
+    uint64_t seed = z_hash_get_seed();
+    size_t offset = strings_offset;
+    Z_Hash_Table_Iter iter = z_hash_table_iter(table);
+    Z_Pair pair;
+
+    while (z_hash_table_iter_next(&iter, &pair)) {
+        size_t key_length = strlen(pair.key);
+        size_t value_length = strlen(pair.value);
+
+        if (key_length > UINT32_MAX || value_length > UINT32_MAX) {
+            return false;
+        }
+
+        size_t hash = z__mapped_table_hash(pair.key, key_length, seed);
+        size_t i = z__group_find_insert_slot(ctrl, capacity, hash);
+
+        z__ctrl_set(ctrl, capacity, i, z__group_h2(hash));
+        slots[i].key_offset = offset;
+        slots[i].key_length = (uint32_t)key_length;
+        slots[i].value_length = (uint32_t)value_length;
+        offset += key_length + value_length + 2;
+    }
+
+    Z_Mapped_Table_Header header = {
+        .magic = Z_MAPPED_TABLE_MAGIC,
+        .byte_order = Z_MAPPED_TABLE_BYTE_ORDER,
+        .reserved = 0,
+        .seed = seed,
+        .size = table->size,
+        .capacity = capacity,
+        .slots_offset = slots_offset,
+        .strings_offset = strings_offset,
+        .file_length = offset,
+    };
+
+    // written next to pathname and renamed over it, so a failed save never
+    // leaves a truncated table behind
+    static const uint8_t padding[8] = {0};
+    Z_String tmp_pathname = z_str_new(&heap, "%s.%ld.tmp", pathname, (long)getpid());
+    int fd = open(tmp_pathname.ptr, O_WRONLY | O_CREAT | O_EXCL, 0666);
+
+    if (fd == -1) {
+        return false;
+    }
+
+    FILE *fp = fdopen(fd, "wb");
+
+    if (!fp) {
+        close(fd);
+        unlink(tmp_pathname.ptr);
+        return false;
+    }
+
+    bool ok = z__mapped_table_write(fp, &header, sizeof(header))
+        && z__mapped_table_write(fp, ctrl, capacity + Z_GROUP_WIDTH)
+        && z__mapped_table_write(fp, padding, slots_offset - sizeof(header) - capacity - Z_GROUP_WIDTH)
+        && z__mapped_table_write(fp, slots, sizeof(Z_Mapped_Table_Slot) * capacity);
+
+    // strings go out in the order their offsets were handed out above
+    iter = z_hash_table_iter(table);
+
+    while (ok && z_hash_table_iter_next(&iter, &pair)) {
+        ok = z__mapped_table_write(fp, pair.key, strlen(pair.key) + 1)
+            && z__mapped_table_write(fp, pair.value, strlen(pair.value) + 1);
+    }
+
+    ok = ok && fflush(fp) == 0 && fsync(fd) == 0;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok || rename(tmp_pathname.ptr, pathname) == -1) {
+        unlink(tmp_pathname.ptr);
+        return false;
+    }
+
+    return true;
+}
+
+bool z_mapped_table_open(Z_Mapped_Table *table, const char *pathname)
+{
+    int fd = open(pathname, O_RDONLY);
+
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(Z_Mapped_Table_Header)) {
+        close(fd);
+        return false;
+    }
+
+    size_t length = (size_t)st.st_size;
+    void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    const Z_Mapped_Table_Header *header = data;
+    size_t capacity = header->capacity;
+
+    bool valid = memcmp(header->magic, Z_MAPPED_TABLE_MAGIC, sizeof(header->magic)) == 0
+        && header->byte_order == Z_MAPPED_TABLE_BYTE_ORDER
+        && header->file_length == length
+        && capacity >= Z_GROUP_WIDTH && (capacity & (capacity - 1)) == 0
+        && header->slots_offset >= sizeof(Z_Mapped_Table_Header) + capacity + Z_GROUP_WIDTH
+        && header->strings_offset == header->slots_offset + sizeof(Z_Mapped_Table_Slot) * capacity
+        && header->strings_offset <= length;
+
+    if (!valid) {
+        munmap(data, length);
+        return false;
+    }
+
+    table->data = data;
+    table->length = length;
+    table->ctrl = table->data + sizeof(Z_Mapped_Table_Header);
+    table->slots = table->data + header->slots_offset;
+    table->capacity = capacity;
+    table->size = header->size;
+    table->seed = header->seed;
+
+    return true;
+}
+
+void z_mapped_table_close(Z_Mapped_Table *table)
+{
+    if (table->data) {
+        munmap(table->data, table->length);
+        table->data = NULL;
+    }
+}
+
+bool z_mapped_table_get_sv(const Z_Mapped_Table *table, Z_String_View key, Z_String_View *value)
+{
+    const Z_Mapped_Table_Slot *slots = table->slots;
+    size_t hash = z__mapped_table_hash(key.ptr, key.length, table->seed);
+    uint8_t h2 = z__group_h2(hash);
+
+    for (Z_Group_Probe probe = z__group_probe(hash, table->capacity);; z__group_probe_next(&probe)) {
+        Z_Group_Mask match = z__group_match(table->ctrl + probe.pos, h2);
+
+        while (match) {
+            const Z_Mapped_Table_Slot *slot = &slots[z__group_probe_slot(&probe, z__group_mask_next(&match))];
+            const char *slot_key = (const char *)table->data + slot->key_offset;
+
+            if (slot->key_length == key.length && memcmp(slot_key, key.ptr, key.length) == 0) {
+                value->ptr = slot_key + slot->key_length + 1;
+                value->length = slot->value_length;
+                return true;
+            }
+        }
+
+        if (z__group_match_empty(table->ctrl + probe.pos)) {
+            return false;
+        }
+    }
+}
+
+const char *z_mapped_table_get(const Z_Mapped_Table *table, const char *key)
+{
+    Z_String_View value;
+
+    if (!z_mapped_table_get_sv(table, z_sv(key), &value)) {
+        return NULL;
+    }
+
+    return value.ptr;
+}
+
+size_t z_mapped_table_size(const Z_Mapped_Table *table)
+{
+    return table->size;
+}
@@ -0,0 +1,254 @@
+#include <z_matcher.h>
+#include <z_error.h>
+
+#define Z_MATCHER_NONE UINT32_MAX
+#define Z_MATCHER_REPORTS ((uint32_t)1 << 31)
+#define Z_MATCHER_ROW_MASK (Z_MATCHER_REPORTS - 1)
+
+void z__matcher_build_trie(Z_Matcher *matcher, const Z_String_Array *patterns, bool ignore_case);
+void z__matcher_link(Z_Matcher *matcher);
+void z__matcher_report(const Z_Matcher *matcher, uint32_t state, size_t end, Z_Match_Array *out);
+bool z__matcher_scan(const Z_Matcher *matcher, uint32_t *row, size_t offset, Z_String_View text, Z_Match_Array *out, Z_Match *first);
+
+static inline unsigned char z__matcher_fold(unsigned char c, bool ignore_case)
+{
+    return ignore_case && c >= 'A' && c <= 'Z' ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static inline Z_Match z__matcher_match(const Z_Matcher *matcher, uint32_t pattern, size_t end)
+{
+    Z_Match match = {
+        .pattern = pattern,
+        .offset = end - matcher->pattern_lengths[pattern],
+    };
+
+    return match;
+}
+
+Z_Matcher z_matcher_new(Z_Heap *heap, const Z_String_Array *patterns, bool ignore_case)
+{
+    Z_Matcher matcher = {
+        .classes = {0},
+        .class_count = 1,
+        .table = NULL,
+        .outputs = NULL,
+        .dict_links = NULL,
+        .pattern_next = z_heap_malloc(heap, sizeof(uint32_t) * patterns->length),
+        .pattern_lengths = z_heap_malloc(heap, sizeof(size_t) * patterns->length),
+        .state_count = 1,
+        .pattern_count = patterns->length,
+        .heap = heap,
+    };
+
+    size_t max_states = 1;
+
+    for (size_t i = 0; i < patterns->length; i++) {
+        const Z_String *pattern = &patterns->ptr[i];
+
+        for (size_t j = 0; j < pattern->length; j++) {
+            unsigned char c = z__matcher_fold((unsigned char)pattern->ptr[j], ignore_case);
+
+            if (matcher.classes[c] == 0) {
+                matcher.classes[c] = (uint16_t)matcher.class_count++;
+            }
+        }
+
+        max_states += pattern->length;
+    }
+
+    if (ignore_case) {
+        for (unsigned char c = 'A'; c <= 'Z'; c++) {
+            matcher.classes[c] = matcher.classes[c + ('a' - 'A')];
+        }
+    }
+
+    if (max_states * matcher.class_count > Z_MATCHER_ROW_MASK) {
+        z_die("z_matcher: patterns too long for the transition table\n");
+    }
+
+    matcher.table = z_heap_calloc(heap, sizeof(uint32_t) * max_states * matcher.class_count);
+    matcher.outputs = z_heap_malloc(heap, sizeof(uint32_t) * max_states);
+    matcher.dict_links = z_heap_malloc(heap, sizeof(uint32_t) * max_states);
+
+    for (size_t i = 0; i < max_states; i++) {
+        matcher.outputs[i] = Z_MATCHER_NONE;
+        matcher.dict_links[i] = Z_MATCHER_NONE;
+    }
+
+    z__matcher_build_trie(&matcher, patterns, ignore_case);
+    z__matcher_link(&matcher);
+
+    matcher.table = z_heap_realloc(heap, matcher.table, sizeof(uint32_t) * matcher.state_count * matcher.class_count);
+    matcher.outputs = z_heap_realloc(heap, matcher.outputs, sizeof(uint32_t) * matcher.state_count);
+    matcher.dict_links = z_heap_realloc(heap, matcher.dict_links, sizeof(uint32_t) * matcher.state_count);
+
+    return matcher;
+}
+
+// Zero entries of the trie are missing edges, no edge leads back to the
+// root. Patterns ending in the same state are chained through pattern_next.
+void z__matcher_build_trie(Z_Matcher *matcher, const Z_String_Array *patterns, bool ignore_case)
+{
+    size_t k = matcher->class_count;
+
+    for (size_t i = 0; i < patterns->length; i++) {
+        const Z_String *pattern = &patterns->ptr[i];
+        uint32_t state = 0;
+
+        matcher->pattern_lengths[i] = pattern->length;
+        matcher->pattern_next[i] = Z_MATCHER_NONE;
+
+        if (pattern->length == 0) {
+            continue;
+        }
+
+        for (size_t j = 0; j < pattern->length; j++) {
+            unsigned char c = z__matcher_fold((unsigned char)pattern->ptr[j], ignore_case);
+            uint32_t *edge = &matcher->table[state * k + matcher->classes[c]];
+
+            if (*edge == 0) {
+                *edge = (uint32_t)matcher->state_count++;
+            }
+
+            state = *edge;
+        }
+
+        matcher->pattern_next[i] = matcher->outputs[state];
+        matcher->outputs[state] = (uint32_t)i;
+    }
+}
+
+// Walks the trie breadth first, so the failure state of every state is
+// complete before the state itself. Missing edges are filled with the edge
+// of the failure state, which turns the trie into a DFA, and every entry
+// ends up holding the row of its target with the reports bit set when the
+// target or anything on its failure chain ends a pattern.
+void z__matcher_link(Z_Matcher *matcher)
+{
+    size_t k = matcher->class_count;
+    uint32_t *table = matcher->table;
+    uint32_t *fail = z_heap_malloc(matcher->heap, sizeof(uint32_t) * matcher->state_count);
+    uint32_t *queue = z_heap_malloc(matcher->heap, sizeof(uint32_t) * matcher->state_count);
+    size_t head = 0;
+    size_t tail = 0;
+
+    fail[0] = 0;
+
+    for (size_t c = 0; c < k; c++) {
+        if (table[c] != 0) {
+            fail[table[c]] = 0;
+            queue[tail++] = table[c];
+        }
+    }
+
+    while (head < tail) {
+        uint32_t state = queue[head++];
+        uint32_t failure = fail[state];
+
+        matcher->dict_links[state] = matcher->outputs[failure] != Z_MATCHER_NONE ? failure : matcher->dict_links[failure];
+
+        for (size_t c = 0; c < k; c++) {
+            uint32_t *edge = &table[state * k + c];
+            uint32_t fallback = table[failure * k + c];
+
+            if (*edge != 0) {
+                fail[*edge] = fallback;
+                queue[tail++] = *edge;
+            } else {
+                *edge = fallback;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < matcher->state_count * k; i++) {
+        uint32_t target = table[i];
+        bool reports = matcher->outputs[target] != Z_MATCHER_NONE || matcher->dict_links[target] != Z_MATCHER_NONE;
+        table[i] = (uint32_t)(target * k) | (reports ? Z_MATCHER_REPORTS : 0);
+    }
+
+    z_heap_free(matcher->heap, fail);
+    z_heap_free(matcher->heap, queue);
+}
+
+void z__matcher_report(const Z_Matcher *matcher, uint32_t state, size_t end, Z_Match_Array *out)
+{
+    if (matcher->outputs[state] == Z_MATCHER_NONE) {
+        state = matcher->dict_links[state];
+    }
+
+    for (; state != Z_MATCHER_NONE; state = matcher->dict_links[state]) {
+        for (uint32_t i = matcher->outputs[state]; i != Z_MATCHER_NONE; i = matcher->pattern_next[i]) {
+            z_array_push(out, z__matcher_match(matcher, i, end));
+        }
+    }
+}
+
+// Runs text through the automaton starting at *row. Every match goes to out,
+// or when out is NULL the scan stops at the first match, the longest of the
+// ones ending first, and stores it in first.
+bool z__matcher_scan(const Z_Matcher *matcher, uint32_t *row, size_t offset, Z_String_View text, Z_Match_Array *out, Z_Match *first)
+{
+    const uint32_t *table = matcher->table;
+    const uint16_t *classes = matcher->classes;
+    const unsigned char *ptr = (const unsigned char *)text.ptr;
+    uint32_t current = *row;
+
+    for (size_t i = 0; i < text.length; i++) {
+        uint32_t entry = table[current + classes[ptr[i]]];
+        current = entry & Z_MATCHER_ROW_MASK;
+
+        if (entry & Z_MATCHER_REPORTS) {
+            uint32_t state = (uint32_t)(current / matcher->class_count);
+
+            if (!out) {
+                if (matcher->outputs[state] == Z_MATCHER_NONE) {
+                    state = matcher->dict_links[state];
+                }
+
+                *row = current;
+                *first = z__matcher_match(matcher, matcher->outputs[state], offset + i + 1);
+                return true;
+            }
+
+            z__matcher_report(matcher, state, offset + i + 1, out);
+        }
+    }
+
+    *row = current;
+    return false;
+}
+
+void z_matcher_find_all(const Z_Matcher *matcher, Z_String_View text, Z_Match_Array *out)
+{
+    uint32_t row = 0;
+    z__matcher_scan(matcher, &row, 0, text, out, NULL);
+}
+
+bool z_matcher_find_first(const Z_Matcher *matcher, Z_String_View text, Z_Match *match)
+{
+    uint32_t row = 0;
+    return z__matcher_scan(matcher, &row, 0, text, NULL, match);
+}
+
+bool z_matcher_contains(const Z_Matcher *matcher, Z_String_View text)
+{
+    Z_Match match;
+    return z_matcher_find_first(matcher, text, &match);
+}
+
+Z_Matcher_Stream z_matcher_stream(const Z_Matcher *matcher)
+{
+    Z_Matcher_Stream stream = {
+        .matcher = matcher,
+        .row = 0,
+        .offset = 0,
+    };
+
+    return stream;
+}
+
+void z_matcher_stream_feed(Z_Matcher_Stream *stream, Z_String_View chunk, Z_Match_Array *out)
+{
+    z__matcher_scan(stream->matcher, &stream->row, stream->offset, chunk, out, NULL);
+    stream->offset += chunk.length;
+}
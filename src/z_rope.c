@@ -0,0 +1,362 @@
+#include <z_rope.h>
+#include <z_error.h>
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <internal/z_math.h>
+
+#if defined(IOV_MAX)
+#define Z_ROPE_IOV_MAX IOV_MAX
+#else
+#define Z_ROPE_IOV_MAX 1024
+#endif
+
+struct Z_Rope_Node {
+    Z_Rope_Node *left;
+    Z_Rope_Node *right;
+    size_t weight;
+    uint32_t priority;
+    uint32_t length;
+    char data[Z_ROPE_CHUNK_SIZE];
+};
+
+Z_Rope_Node *z__rope_node_new(Z_Rope *rope, const char *data, size_t length);
+void z__rope_split(Z_Rope_Node *node, size_t position, Z_Rope_Node **left, Z_Rope_Node **right);
+Z_Rope_Node *z__rope_merge(Z_Rope_Node *left, Z_Rope_Node *right);
+void z__rope_link(Z_Rope *rope, size_t position, Z_Rope_Node *node);
+void z__rope_flush_tail(Z_Rope *rope);
+Z_Rope_Node *z__rope_descend(Z_Rope *rope, size_t position, size_t added, size_t removed, size_t *offset);
+void z__rope_free_nodes(Z_Heap *heap, Z_Rope_Node *node);
+void z__rope_collect(const Z_Rope_Node *node, struct iovec *chunks, size_t *count);
+
+static inline size_t z__rope_weight(const Z_Rope_Node *node)
+{
+    return node ? node->weight : 0;
+}
+
+static inline void z__rope_update(Z_Rope_Node *node)
+{
+    node->weight = z__rope_weight(node->left) + node->length + z__rope_weight(node->right);
+}
+
+Z_Rope z_rope_new(Z_Heap *heap)
+{
+    Z_Rope rope = {
+        .root = NULL,
+        .tail = NULL,
+        .length = 0,
+        .chunk_count = 0,
+        .seed = 0x9e3779b97f4a7c15,
+        .heap = heap,
+    };
+
+    return rope;
+}
+
+Z_Rope_Node *z__rope_node_new(Z_Rope *rope, const char *data, size_t length)
+{
+    Z_Rope_Node *node = z_heap_malloc(rope->heap, sizeof(Z_Rope_Node));
+
+    if (!node) {
+        z_die("z_rope: out of memory\n");
+    }
+
+    // xorshift64, priorities only have to be independent of the text
+    rope->seed ^= rope->seed << 13;
+    rope->seed ^= rope->seed >> 7;
+    rope->seed ^= rope->seed << 17;
+
+    node->left = NULL;
+    node->right = NULL;
+    node->weight = length;
+    node->priority = (uint32_t)(rope->seed >> 32);
+    node->length = (uint32_t)length;
+    rope->chunk_count++;
+
+    if (length > 0) {
+        memcpy(node->data, data, length);
+    }
+
+    return node;
+}
+
+// Splits the tree into the nodes before position and the nodes after it,
+// position has to fall between two nodes.
+void z__rope_split(Z_Rope_Node *node, size_t position, Z_Rope_Node **left, Z_Rope_Node **right)
+{
+    if (!node) {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+
+    size_t left_weight = z__rope_weight(node->left);
+
+    if (position <= left_weight) {
+        z__rope_split(node->left, position, left, &node->left);
+        *right = node;
+    } else {
+        z__rope_split(node->right, position - left_weight - node->length, &node->right, right);
+        *left = node;
+    }
+
+    z__rope_update(node);
+}
+
+Z_Rope_Node *z__rope_merge(Z_Rope_Node *left, Z_Rope_Node *right)
+{
+    if (!left) {
+        return right;
+    }
+
+    if (!right) {
+        return left;
+    }
+
+    if (left->priority > right->priority) {
+        left->right = z__rope_merge(left->right, right);
+        z__rope_update(left);
+        return left;
+    }
+
+    right->left = z__rope_merge(left, right->left);
+    z__rope_update(right);
+    return right;
+}
+
+void z__rope_link(Z_Rope *rope, size_t position, Z_Rope_Node *node)
+{
+    Z_Rope_Node *left;
+    Z_Rope_Node *right;
+
+    z__rope_split(rope->root, position, &left, &right);
+    rope->root = z__rope_merge(z__rope_merge(left, node), right);
+}
+
+void z__rope_flush_tail(Z_Rope *rope)
+{
+    if (rope->tail) {
+        rope->root = z__rope_merge(rope->root, rope->tail);
+        rope->tail = NULL;
+    }
+}
+
+// Finds the node holding position, counted from the start of the tree, and
+// the offset of position in it. A position between two nodes may be found
+// at the end of the first. Every node on the way has its weight adjusted by
+// added - removed, so the path can be walked again to account for bytes
+// put in or taken out of the node found.
+Z_Rope_Node *z__rope_descend(Z_Rope *rope, size_t position, size_t added, size_t removed, size_t *offset)
+{
+    Z_Rope_Node *node = rope->root;
+
+    while (true) {
+        size_t left_weight = z__rope_weight(node->left);
+        node->weight = node->weight + added - removed;
+
+        if (position < left_weight) {
+            node = node->left;
+        } else if (position <= left_weight + node->length) {
+            *offset = position - left_weight;
+            return node;
+        } else {
+            position -= left_weight + node->length;
+            node = node->right;
+        }
+    }
+}
+
+void z_rope_append_str(Z_Rope *rope, Z_String_View s)
+{
+    while (s.length > 0) {
+        if (!rope->tail || rope->tail->length == Z_ROPE_CHUNK_SIZE) {
+            z__rope_flush_tail(rope);
+            rope->tail = z__rope_node_new(rope, NULL, 0);
+        }
+
+        Z_Rope_Node *tail = rope->tail;
+        size_t n = z__min_size_t(s.length, Z_ROPE_CHUNK_SIZE - tail->length);
+
+        memcpy(tail->data + tail->length, s.ptr, n);
+        tail->length += (uint32_t)n;
+        tail->weight += n;
+        rope->length += n;
+        s = z_sv_advance(s, n);
+    }
+}
+
+void z_rope_append_char(Z_Rope *rope, char c)
+{
+    Z_String_View s = { .ptr = &c, .length = 1 };
+    z_rope_append_str(rope, s);
+}
+
+// Positions in the tail chunk stay there while it has room, anything else
+// goes through the tree. Bytes go into the node holding position while it
+// has room. A full node
+// is cut at position and its tail moved to a new node, which leaves room on
+// both sides of the cut. At either edge of a full node the bytes go to a
+// new node instead.
+void z_rope_insert(Z_Rope *rope, size_t position, Z_String_View s)
+{
+    assert(position <= rope->length);
+
+    if (position == rope->length) {
+        z_rope_append_str(rope, s);
+        return;
+    }
+
+    Z_Rope_Node *tail = rope->tail;
+    size_t tree_length = rope->length - (tail ? tail->length : 0);
+
+    if (position >= tree_length) {
+        size_t offset = position - tree_length;
+
+        if (s.length <= Z_ROPE_CHUNK_SIZE - tail->length) {
+            memmove(tail->data + offset + s.length, tail->data + offset, tail->length - offset);
+            memcpy(tail->data + offset, s.ptr, s.length);
+            tail->length += (uint32_t)s.length;
+            tail->weight += s.length;
+            rope->length += s.length;
+            return;
+        }
+
+        z__rope_flush_tail(rope);
+    }
+
+    rope->length += s.length;
+
+    while (s.length > 0) {
+        size_t offset;
+        Z_Rope_Node *node = z__rope_descend(rope, position, 0, 0, &offset);
+        size_t room = Z_ROPE_CHUNK_SIZE - node->length;
+
+        if (room > 0) {
+            size_t n = z__min_size_t(room, s.length);
+            z__rope_descend(rope, position, n, 0, &offset);
+
+            memmove(node->data + offset + n, node->data + offset, node->length - offset);
+            memcpy(node->data + offset, s.ptr, n);
+            node->length += (uint32_t)n;
+
+            position += n;
+            s = z_sv_advance(s, n);
+        } else if (offset == 0 || offset == node->length) {
+            size_t n = z__min_size_t(Z_ROPE_CHUNK_SIZE, s.length);
+            z__rope_link(rope, position, z__rope_node_new(rope, s.ptr, n));
+
+            position += n;
+            s = z_sv_advance(s, n);
+        } else {
+            size_t moved = node->length - offset;
+            Z_Rope_Node *next = z__rope_node_new(rope, node->data + offset, moved);
+
+            z__rope_descend(rope, position, 0, moved, &offset);
+            node->length -= (uint32_t)moved;
+            z__rope_link(rope, position, next);
+        }
+    }
+}
+
+size_t z_rope_length(const Z_Rope *rope)
+{
+    return rope->length;
+}
+
+void z__rope_free_nodes(Z_Heap *heap, Z_Rope_Node *node)
+{
+    if (node) {
+        z__rope_free_nodes(heap, node->left);
+        z__rope_free_nodes(heap, node->right);
+        z_heap_free(heap, node);
+    }
+}
+
+void z_rope_clear(Z_Rope *rope)
+{
+    z__rope_free_nodes(rope->heap, rope->root);
+    z__rope_free_nodes(rope->heap, rope->tail);
+
+    rope->root = NULL;
+    rope->tail = NULL;
+    rope->length = 0;
+    rope->chunk_count = 0;
+}
+
+void z__rope_collect(const Z_Rope_Node *node, struct iovec *chunks, size_t *count)
+{
+    if (node) {
+        z__rope_collect(node->left, chunks, count);
+        chunks[*count].iov_base = (void *)(uintptr_t)node->data;
+        chunks[*count].iov_len = node->length;
+        (*count)++;
+        z__rope_collect(node->right, chunks, count);
+    }
+}
+
+Z_String z_rope_to_str(const Z_Rope *rope, Z_Heap *heap)
+{
+    struct iovec *chunks = z_heap_malloc(rope->heap, sizeof(struct iovec) * (rope->chunk_count + 1));
+    size_t count = 0;
+
+    z__rope_collect(rope->root, chunks, &count);
+    z__rope_collect(rope->tail, chunks, &count);
+
+    Z_String s = z_array_new(heap, Z_String);
+    z_array_ensure_capacity(&s, rope->length + 1);
+
+    for (size_t i = 0; i < count; i++) {
+        memcpy(s.ptr + s.length, chunks[i].iov_base, chunks[i].iov_len);
+        s.length += chunks[i].iov_len;
+    }
+
+    s.ptr[s.length] = 0;
+    z_heap_free(rope->heap, chunks);
+
+    return s;
+}
+
+bool z_rope_write(const Z_Rope *rope, int fd)
+{
+    struct iovec *chunks = z_heap_malloc(rope->heap, sizeof(struct iovec) * (rope->chunk_count + 1));
+    size_t count = 0;
+
+    z__rope_collect(rope->root, chunks, &count);
+    z__rope_collect(rope->tail, chunks, &count);
+
+    struct iovec *next = chunks;
+    struct iovec *end = chunks + count;
+    bool ok = true;
+
+    while (next < end) {
+        ssize_t written = writev(fd, next, (int)z__min_size_t((size_t)(end - next), Z_ROPE_IOV_MAX));
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            ok = false;
+            break;
+        }
+
+        // skips what was written, a chunk written in part is trimmed in place
+        size_t left = (size_t)written;
+
+        while (next < end && left >= next->iov_len) {
+            left -= next->iov_len;
+            next++;
+        }
+
+        if (next < end) {
+            next->iov_base = (char *)next->iov_base + left;
+            next->iov_len -= left;
+        }
+    }
+
+    z_heap_free(rope->heap, chunks);
+
+    return ok;
+}
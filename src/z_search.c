@@ -0,0 +1,368 @@
+#include <z_string.h>
+#include <stdint.h>
+#include <string.h>
+#include <internal/z_math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define Z_SEARCH_X86
+#endif
+
+// Needles up to this length are found by filtering candidate positions on
+// their first and last byte a vector at a time, longer ones go to Two-Way
+// which never compares a haystack byte more than twice.
+#define Z_SEARCH_SHORT_NEEDLE 32
+#define Z_SEARCH_NOT_FOUND SIZE_MAX
+
+typedef struct {
+    const unsigned char *ptr;
+    size_t length;
+    bool reverse;
+} Z_Search_Text;
+
+size_t z__search_short(const unsigned char *h, size_t n, const unsigned char *needle, size_t m);
+size_t z__search_short_last(const unsigned char *h, size_t n, const unsigned char *needle, size_t m);
+size_t z__search_scalar(const unsigned char *h, size_t start, size_t end, const unsigned char *needle, size_t m);
+size_t z__search_scalar_last(const unsigned char *h, size_t end, const unsigned char *needle, size_t m);
+size_t z__search_two_way(Z_Search_Text haystack, Z_Search_Text needle);
+size_t z__search_maximal_suffix(Z_Search_Text needle, bool reverse_order, size_t *period);
+
+#if defined(Z_SEARCH_X86)
+size_t z__search_short_avx2(const unsigned char *h, size_t n, const unsigned char *needle, size_t m);
+size_t z__search_short_last_avx2(const unsigned char *h, size_t n, const unsigned char *needle, size_t m);
+#endif
+
+// byte i of the text, counted from the end when it is searched backwards
+static inline unsigned char z__search_at(Z_Search_Text text, size_t i)
+{
+    return text.reverse ? text.ptr[text.length - 1 - i] : text.ptr[i];
+}
+
+static inline bool z__search_matches_at(const unsigned char *h, size_t i, const unsigned char *needle, size_t m)
+{
+    return h[i] == needle[0] && h[i + m - 1] == needle[m - 1] && memcmp(h + i + 1, needle + 1, m - 1) == 0;
+}
+
+// candidates in [start, end]
+size_t z__search_scalar(const unsigned char *h, size_t start, size_t end, const unsigned char *needle, size_t m)
+{
+    for (size_t i = start; i <= end; i++) {
+        if (z__search_matches_at(h, i, needle, m)) {
+            return i;
+        }
+    }
+
+    return Z_SEARCH_NOT_FOUND;
+}
+
+// candidates in [0, end), last first
+size_t z__search_scalar_last(const unsigned char *h, size_t end, const unsigned char *needle, size_t m)
+{
+    for (size_t i = end; i-- > 0;) {
+        if (z__search_matches_at(h, i, needle, m)) {
+            return i;
+        }
+    }
+
+    return Z_SEARCH_NOT_FOUND;
+}
+
+#if defined(Z_SEARCH_X86)
+
+__attribute__((target("avx2")))
+size_t z__search_short_avx2(const unsigned char *h, size_t n, const unsigned char *needle, size_t m)
+{
+    __m256i first = _mm256_set1_epi8((char)needle[0]);
+    __m256i last = _mm256_set1_epi8((char)needle[m - 1]);
+    size_t i = 0;
+
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const void *)(h + i));
+        __m256i b = _mm256_loadu_si256((const void *)(h + i + m - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            size_t bit = (size_t)__builtin_ctz(mask);
+
+            if (memcmp(h + i + bit + 1, needle + 1, m - 1) == 0) {
+                return i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return z__search_scalar(h, i, n - m, needle, m);
+}
+
+__attribute__((target("avx2")))
+size_t z__search_short_last_avx2(const unsigned char *h, size_t n, const unsigned char *needle, size_t m)
+{
+    __m256i first = _mm256_set1_epi8((char)needle[0]);
+    __m256i last = _mm256_set1_epi8((char)needle[m - 1]);
+    size_t end = n - m + 1;
+
+    for (; end >= 32; end -= 32) {
+        size_t i = end - 32;
+        __m256i a = _mm256_loadu_si256((const void *)(h + i));
+        __m256i b = _mm256_loadu_si256((const void *)(h + i + m - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            size_t bit = 31 - (size_t)__builtin_clz(mask);
+
+            if (memcmp(h + i + bit + 1, needle + 1, m - 1) == 0) {
+                return i + bit;
+            }
+
+            mask &= ~(1u << bit);
+        }
+    }
+
+    return z__search_scalar_last(h, end, needle, m);
+}
+
+#endif
+
+size_t z__search_short(const unsigned char *h, size_t n, const unsigned char *needle, size_t m)
+{
+#if defined(Z_SEARCH_X86)
+    if (__builtin_cpu_supports("avx2")) {
+        return z__search_short_avx2(h, n, needle, m);
+    }
+#endif
+
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    __m128i first = _mm_set1_epi8((char)needle[0]);
+    __m128i last = _mm_set1_epi8((char)needle[m - 1]);
+
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const void *)(h + i));
+        __m128i b = _mm_loadu_si128((const void *)(h + i + m - 1));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            size_t bit = (size_t)__builtin_ctz(mask);
+
+            if (memcmp(h + i + bit + 1, needle + 1, m - 1) == 0) {
+                return i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    return z__search_scalar(h, i, n - m, needle, m);
+}
+
+size_t z__search_short_last(const unsigned char *h, size_t n, const unsigned char *needle, size_t m)
+{
+#if defined(Z_SEARCH_X86)
+    if (__builtin_cpu_supports("avx2")) {
+        return z__search_short_last_avx2(h, n, needle, m);
+    }
+#endif
+
+    size_t end = n - m + 1;
+
+#if defined(__SSE2__)
+    __m128i first = _mm_set1_epi8((char)needle[0]);
+    __m128i last = _mm_set1_epi8((char)needle[m - 1]);
+
+    for (; end >= 16; end -= 16) {
+        size_t i = end - 16;
+        __m128i a = _mm_loadu_si128((const void *)(h + i));
+        __m128i b = _mm_loadu_si128((const void *)(h + i + m - 1));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            size_t bit = 31 - (size_t)__builtin_clz(mask);
+
+            if (memcmp(h + i + bit + 1, needle + 1, m - 1) == 0) {
+                return i + bit;
+            }
+
+            mask &= ~(1u << bit);
+        }
+    }
+#endif
+
+    return z__search_scalar_last(h, end, needle, m);
+}
+
+// Start of the maximal suffix of needle under the byte order, or under the
+// reversed order, minus one (SIZE_MAX for the whole needle). Stores the
+// period of that suffix.
+size_t z__search_maximal_suffix(Z_Search_Text needle, bool reverse_order, size_t *period)
+{
+    size_t start = SIZE_MAX;
+    size_t j = 0;
+    size_t k = 1;
+    size_t p = 1;
+
+    while (j + k < needle.length) {
+        unsigned char a = z__search_at(needle, start + k);
+        unsigned char b = z__search_at(needle, j + k);
+
+        if (a == b) {
+            if (k == p) {
+                j += p;
+                k = 1;
+            } else {
+                k++;
+            }
+        } else if ((a > b) != reverse_order) {
+            j += k;
+            k = 1;
+            p = j - start;
+        } else {
+            start = j++;
+            k = p = 1;
+        }
+    }
+
+    *period = p;
+    return start;
+}
+
+// Crochemore-Perrin Two-Way with the last byte shift table of musl's
+// memmem. Positions are counted from the end of both texts when they are
+// reversed, so the same loop finds the last match.
+size_t z__search_two_way(Z_Search_Text haystack, Z_Search_Text needle)
+{
+    size_t m = needle.length;
+    size_t shift[256] = {0};
+
+    for (size_t i = 0; i < m; i++) {
+        shift[z__search_at(needle, i)] = i + 1;
+    }
+
+    size_t period;
+    size_t opposite_period;
+    size_t split = z__search_maximal_suffix(needle, false, &period);
+    size_t opposite_split = z__search_maximal_suffix(needle, true, &opposite_period);
+
+    if (opposite_split + 1 > split + 1) {
+        split = opposite_split;
+        period = opposite_period;
+    }
+
+    // a periodic needle remembers how much of the previous window matched
+    bool periodic = true;
+
+    for (size_t i = 0; i < split + 1; i++) {
+        if (z__search_at(needle, i) != z__search_at(needle, i + period)) {
+            periodic = false;
+            break;
+        }
+    }
+
+    size_t memory_after_shift = 0;
+
+    if (!periodic) {
+        period = z__max_size_t(split, m - split - 1) + 1;
+    } else {
+        memory_after_shift = m - period;
+    }
+
+    size_t memory = 0;
+
+    for (size_t pos = 0; pos + m <= haystack.length;) {
+        size_t skip = m - shift[z__search_at(haystack, pos + m - 1)];
+
+        if (skip) {
+            pos += z__max_size_t(skip, memory);
+            memory = 0;
+            continue;
+        }
+
+        size_t k = z__max_size_t(split + 1, memory);
+
+        while (k < m && z__search_at(needle, k) == z__search_at(haystack, pos + k)) {
+            k++;
+        }
+
+        if (k < m) {
+            pos += k - split;
+            memory = 0;
+            continue;
+        }
+
+        k = split + 1;
+
+        while (k > memory && z__search_at(needle, k - 1) == z__search_at(haystack, pos + k - 1)) {
+            k--;
+        }
+
+        if (k <= memory) {
+            return pos;
+        }
+
+        pos += period;
+        memory = memory_after_shift;
+    }
+
+    return Z_SEARCH_NOT_FOUND;
+}
+
+ssize_t z_sv_find_index(Z_String_View haystack, Z_String_View needle)
+{
+    if (needle.length == 0) {
+        return 0;
+    }
+
+    if (needle.length > haystack.length) {
+        return -1;
+    }
+
+    const unsigned char *h = (const unsigned char *)haystack.ptr;
+    const unsigned char *n = (const unsigned char *)needle.ptr;
+    size_t i;
+
+    if (needle.length == 1) {
+        const unsigned char *found = memchr(h, n[0], haystack.length);
+        return found ? found - h : -1;
+    }
+
+    if (needle.length <= Z_SEARCH_SHORT_NEEDLE) {
+        i = z__search_short(h, haystack.length, n, needle.length);
+    } else {
+        Z_Search_Text text = { .ptr = h, .length = haystack.length, .reverse = false };
+        Z_Search_Text pattern = { .ptr = n, .length = needle.length, .reverse = false };
+        i = z__search_two_way(text, pattern);
+    }
+
+    return i == Z_SEARCH_NOT_FOUND ? -1 : (ssize_t)i;
+}
+
+ssize_t z_sv_find_last_index(Z_String_View haystack, Z_String_View needle)
+{
+    if (needle.length > haystack.length) {
+        return -1;
+    }
+
+    if (needle.length == 0) {
+        return (ssize_t)haystack.length;
+    }
+
+    const unsigned char *h = (const unsigned char *)haystack.ptr;
+    const unsigned char *n = (const unsigned char *)needle.ptr;
+    size_t i;
+
+    if (needle.length <= Z_SEARCH_SHORT_NEEDLE) {
+        i = z__search_short_last(h, haystack.length, n, needle.length);
+    } else {
+        Z_Search_Text text = { .ptr = h, .length = haystack.length, .reverse = true };
+        Z_Search_Text pattern = { .ptr = n, .length = needle.length, .reverse = true };
+        i = z__search_two_way(text, pattern);
+
+        if (i != Z_SEARCH_NOT_FOUND) {
+            i = haystack.length - needle.length - i;
+        }
+    }
+
+    return i == Z_SEARCH_NOT_FOUND ? -1 : (ssize_t)i;
+}
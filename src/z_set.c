@@ -0,0 +1,342 @@
+#include <z_set.h>
+#include <internal/z_group.h>
+#include <internal/z_math.h>
+
+#define Z_SET_NOT_FOUND SIZE_MAX
+
+Z_Set z__set_new_exact(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity);
+void z__set_free(Z_Set *set);
+size_t z__set_find(const Z_Set *set, const void *key, size_t hash);
+void z__set_insert_at(Z_Set *set, size_t i, void *key, size_t hash);
+void z__set_resize(Z_Set *set, size_t new_capacity);
+size_t z__set_slot_hash(const void *set, size_t i);
+void z__set_swap_slots(void *set, size_t a, size_t b);
+void z__set_rehash_in_place(Z_Set *set);
+void z__set_make_room(Z_Set *set);
+const Z_Set *z__set_smaller(const Z_Set *a, const Z_Set *b);
+
+Z_Set z_set_new(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash)
+{
+    return z__set_new_exact(heap, equal, hash, 0);
+}
+
+Z_Set z_set_new_with_capacity(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity)
+{
+    return z__set_new_exact(heap, equal, hash, z__hash_table_capacity_for(capacity));
+}
+
+Z_Set z__set_new_exact(Z_Heap *heap, Z_Equal_Fn equal, Z_Hash_Fn hash, size_t capacity)
+{
+    Z_Set set = {
+        .ctrl = NULL,
+        .keys = NULL,
+        .occupied = 0,
+        .size = 0,
+        .capacity = capacity,
+        .equal = equal,
+        .hash = hash,
+        .heap = heap,
+    };
+
+    if (capacity > 0) {
+        set.ctrl = z_heap_malloc(heap, capacity + Z_GROUP_WIDTH);
+        set.keys = z_heap_malloc(heap, sizeof(void *) * capacity);
+        memset(set.ctrl, Z_CTRL_EMPTY, capacity + Z_GROUP_WIDTH);
+    }
+
+    return set;
+}
+
+void z__set_free(Z_Set *set)
+{
+    if (set->capacity == 0) {
+        return;
+    }
+
+    z_heap_free(set->heap, set->ctrl);
+    z_heap_free(set->heap, set->keys);
+}
+
+Z_Set z_set_clone(Z_Heap *heap, const Z_Set *set)
+{
+    Z_Set clone = z__set_new_exact(heap, set->equal, set->hash, set->capacity);
+
+    if (set->capacity > 0) {
+        memcpy(clone.ctrl, set->ctrl, set->capacity + Z_GROUP_WIDTH);
+        memcpy(clone.keys, set->keys, sizeof(void *) * set->capacity);
+    }
+
+    clone.occupied = set->occupied;
+    clone.size = set->size;
+
+    return clone;
+}
+
+static inline size_t z__set_hash(const Z_Set *set, const void *key)
+{
+    return z__group_mix(set->hash(key));
+}
+
+size_t z__set_find(const Z_Set *set, const void *key, size_t hash)
+{
+    if (set->capacity == 0) {
+        return Z_SET_NOT_FOUND;
+    }
+
+    uint8_t h2 = z__group_h2(hash);
+
+    for (Z_Group_Probe probe = z__group_probe(hash, set->capacity);; z__group_probe_next(&probe)) {
+        Z_Group_Mask match = z__group_match(set->ctrl + probe.pos, h2);
+
+        while (match) {
+            size_t i = z__group_probe_slot(&probe, z__group_mask_next(&match));
+
+            if (set->equal(set->keys[i], key)) {
+                return i;
+            }
+        }
+
+        if (z__group_match_empty(set->ctrl + probe.pos)) {
+            return Z_SET_NOT_FOUND;
+        }
+    }
+}
+
+void z__set_insert_at(Z_Set *set, size_t i, void *key, size_t hash)
+{
+    if (set->ctrl[i] == Z_CTRL_EMPTY) {
+        set->occupied++;
+    }
+
+    z__ctrl_set(set->ctrl, set->capacity, i, z__group_h2(hash));
+    set->keys[i] = key;
+    set->size++;
+}
+
+void z__set_resize(Z_Set *set, size_t new_capacity)
+{
+    Z_Set new_set = z__set_new_exact(set->heap, set->equal, set->hash, new_capacity);
+
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (z__ctrl_is_full(set->ctrl[i])) {
+            size_t hash = z__set_hash(set, set->keys[i]);
+            z__set_insert_at(&new_set, z__group_find_insert_slot(new_set.ctrl, new_set.capacity, hash), set->keys[i], hash);
+        }
+    }
+
+    z__set_free(set);
+    *set = new_set;
+}
+
+size_t z__set_slot_hash(const void *set, size_t i)
+{
+    const Z_Set *s = set;
+    return z__set_hash(s, s->keys[i]);
+}
+
+void z__set_swap_slots(void *set, size_t a, size_t b)
+{
+    Z_Set *s = set;
+    void *key = s->keys[a];
+    s->keys[a] = s->keys[b];
+    s->keys[b] = key;
+}
+
+void z__set_rehash_in_place(Z_Set *set)
+{
+    z__group_rehash_in_place(set->ctrl, set->capacity, set, z__set_slot_hash, z__set_swap_slots);
+    set->occupied = set->size;
+}
+
+void z__set_make_room(Z_Set *set)
+{
+    if (set->capacity > 0 && (double)set->size <= (double)set->capacity * Z_HASH_TABLE_MAX_LOAD_FACTOR / 2) {
+        z__set_rehash_in_place(set);
+    } else {
+        z__set_resize(set, z__max_size_t(Z_HASH_TABLE_MIN_CAPACITY, set->capacity * 2));
+    }
+}
+
+bool z_set_add(Z_Set *set, void *key)
+{
+    if ((double)set->occupied >= (double)set->capacity * Z_HASH_TABLE_MAX_LOAD_FACTOR) {
+        z__set_make_room(set);
+    }
+
+    size_t hash = z__set_hash(set, key);
+
+    if (z__set_find(set, key, hash) != Z_SET_NOT_FOUND) {
+        return false;
+    }
+
+    z__set_insert_at(set, z__group_find_insert_slot(set->ctrl, set->capacity, hash), key, hash);
+
+    return true;
+}
+
+bool z_set_remove(Z_Set *set, const void *key)
+{
+    if (set->size == 0) {
+        return false;
+    }
+
+    size_t i = z__set_find(set, key, z__set_hash(set, key));
+
+    if (i == Z_SET_NOT_FOUND) {
+        return false;
+    }
+
+    if (z__ctrl_erase(set->ctrl, set->capacity, i)) {
+        set->occupied--;
+    }
+
+    set->size--;
+
+    return true;
+}
+
+bool z_set_contains(const Z_Set *set, const void *key)
+{
+    if (set->size == 0) {
+        return false;
+    }
+
+    return z__set_find(set, key, z__set_hash(set, key)) != Z_SET_NOT_FOUND;
+}
+
+void *z_set_get(const Z_Set *set, const void *key)
+{
+    if (set->size == 0) {
+        return NULL;
+    }
+
+    size_t i = z__set_find(set, key, z__set_hash(set, key));
+
+    return i == Z_SET_NOT_FOUND ? NULL : set->keys[i];
+}
+
+size_t z_set_size(const Z_Set *set)
+{
+    return set->size;
+}
+
+void z_set_reserve(Z_Set *set, size_t size)
+{
+    size_t new_capacity = z__hash_table_capacity_for(size);
+
+    if (new_capacity > set->capacity) {
+        z__set_resize(set, new_capacity);
+    }
+}
+
+void z_set_clear(Z_Set *set)
+{
+    if (set->capacity > 0) {
+        memset(set->ctrl, Z_CTRL_EMPTY, set->capacity + Z_GROUP_WIDTH);
+    }
+
+    set->occupied = 0;
+    set->size = 0;
+}
+
+const Z_Set *z__set_smaller(const Z_Set *a, const Z_Set *b)
+{
+    return a->size <= b->size ? a : b;
+}
+
+Z_Set z_set_union(Z_Heap *heap, const Z_Set *a, const Z_Set *b)
+{
+    const Z_Set *smaller = z__set_smaller(a, b);
+    Z_Set result = z_set_clone(heap, smaller == a ? b : a);
+
+    for (size_t i = 0; i < smaller->capacity; i++) {
+        if (z__ctrl_is_full(smaller->ctrl[i])) {
+            z_set_add(&result, smaller->keys[i]);
+        }
+    }
+
+    return result;
+}
+
+Z_Set z_set_intersection(Z_Heap *heap, const Z_Set *a, const Z_Set *b)
+{
+    const Z_Set *smaller = z__set_smaller(a, b);
+    const Z_Set *bigger = smaller == a ? b : a;
+    Z_Set result = z_set_new_with_capacity(heap, a->equal, a->hash, smaller->size);
+
+    for (size_t i = 0; i < smaller->capacity; i++) {
+        if (z__ctrl_is_full(smaller->ctrl[i]) && z_set_contains(bigger, smaller->keys[i])) {
+            z_set_add(&result, smaller->keys[i]);
+        }
+    }
+
+    return result;
+}
+
+// keys of a missing from b, when b is the smaller one a is cloned and b's
+// keys removed from it
+Z_Set z_set_difference(Z_Heap *heap, const Z_Set *a, const Z_Set *b)
+{
+    if (b->size < a->size) {
+        Z_Set result = z_set_clone(heap, a);
+
+        for (size_t i = 0; i < b->capacity; i++) {
+            if (z__ctrl_is_full(b->ctrl[i])) {
+                z_set_remove(&result, b->keys[i]);
+            }
+        }
+
+        return result;
+    }
+
+    Z_Set result = z_set_new_with_capacity(heap, a->equal, a->hash, a->size);
+
+    for (size_t i = 0; i < a->capacity; i++) {
+        if (z__ctrl_is_full(a->ctrl[i]) && !z_set_contains(b, a->keys[i])) {
+            z_set_add(&result, a->keys[i]);
+        }
+    }
+
+    return result;
+}
+
+bool z_set_is_subset(const Z_Set *a, const Z_Set *b)
+{
+    if (a->size > b->size) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a->capacity; i++) {
+        if (z__ctrl_is_full(a->ctrl[i]) && !z_set_contains(b, a->keys[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Z_Set_Iter z_set_iter(const Z_Set *set)
+{
+    Z_Set_Iter iter = {
+        .set = set,
+        .i = 0,
+    };
+
+    return iter;
+}
+
+bool z_set_iter_next(Z_Set_Iter *iter, void **key)
+{
+    const Z_Set *set = iter->set;
+
+    while (iter->i < set->capacity) {
+        size_t i = iter->i++;
+
+        if (z__ctrl_is_full(set->ctrl[i])) {
+            *key = set->keys[i];
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -1,13 +1,19 @@
 #include <z_string.h>
 #include <z_array.h>
+#include <z_hash_table.h>
 #include <limits.h>
 #include <stdio.h>
 #include <internal/z_math.h>
 
 #define Z__WHITE_SPACE " \f\n\r\t\v"
+#define Z__REPLACE_STACK_TARGETS 8
 
 int z__size_t_to_int(size_t a);
+size_t z__str_replace_next(Z_String_View text, const Z_String_View *targets, size_t count, size_t *next, size_t cursor, size_t *which);
+void z__str_replace_start(Z_String_View text, const Z_String_View *targets, size_t count, size_t *next);
+bool z__str_overlaps(const Z_String *s, Z_String_View view);
 size_t z__get_format_length(const char *format, va_list args);
+void z__str_open_front(Z_String *s, size_t n);
 
 int z__size_t_to_int(size_t a)
 {
@@ -41,9 +47,21 @@ Z_String z_str_new_args(Z_Heap *heap, const char *format, va_list args)
     return s;
 }
 
+// One allocation of the exact size, most strings made from views are split
+// tokens and keys that never grow.
 Z_String z_str_new_from_sv(Z_Heap *heap, Z_String_View s)
 {
-    return z_str_new(heap, "%.*s", z__size_t_to_int(s.length), s.ptr);
+    Z_String str = {
+        .heap = heap,
+        .ptr = z_heap_malloc(heap, sizeof(char) * (s.length + 1)),
+        .length = s.length,
+        .capacity = s.length + 1,
+    };
+
+    memcpy(str.ptr, s.ptr, sizeof(char) * s.length);
+    str.ptr[s.length] = 0;
+
+    return str;
 }
 
 char *z_sv_to_cstr(Z_Heap *heap, Z_String_View s)
@@ -115,7 +133,7 @@ bool z_str_append_file(Z_String *s, const char *pathname)
 
     size_t file_size = z__get_file_size(fp);
 
-    z_array_ensure_capacity(s, s->length + file_size);
+    z_array_ensure_capacity(s, s->length + file_size + 1);
     s->length += fread(s->ptr + s->length, 1, file_size, fp);
     z_array_zero_terminate(s);
     fclose(fp);
@@ -134,21 +152,49 @@ void z_str_prepend_format(Z_String *s, const char *format, ...)
 
 void z_str_prepend_va(Z_String *s, const char *format, va_list args)
 {
-    Z_Heap_Auto heap = {0};
-    Z_String tmp = z_str_new_args(&heap, format, args);
-    z_str_append_format(&tmp, "%s", s->ptr);
-    z_str_clear(s);
-    z_str_append_format(s, "%s", tmp.ptr);
+    size_t format_length = z__get_format_length(format, args);
+    z__str_open_front(s, format_length);
+
+    // vsnprintf terminates what it writes, over the first byte of the old text
+    char first = s->ptr[format_length];
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    vsnprintf(s->ptr, format_length + 1, format, args_copy);
+    va_end(args_copy);
+
+    s->ptr[format_length] = first;
 }
 
 void z_str_prepend_str(Z_String *target, Z_String_View source)
 {
-    z_str_prepend_format(target, "%.*s", z__size_t_to_int(source.length), source.ptr);
+    bool overlaps = z__str_overlaps(target, source);
+    size_t offset = overlaps ? (size_t)(source.ptr - target->ptr) : 0;
+
+    z__str_open_front(target, source.length);
+
+    if (overlaps) {
+        source.ptr = target->ptr + source.length + offset;
+    }
+
+    memmove(target->ptr, source.ptr, sizeof(char) * source.length);
 }
 
 void z_str_prepend_char(Z_String *s, char c)
 {
-    z_str_prepend_format(s, "%c", c);
+    z__str_open_front(s, 1);
+    s->ptr[0] = c;
+}
+
+// Moves the text, terminator included, n bytes to the right. Z_String keeps
+// no room in front, so every prepend copies the text once; Z_String_Builder
+// is the type to use when a string is built back to front.
+void z__str_open_front(Z_String *s, size_t n)
+{
+    z_array_ensure_capacity(s, s->length + n + 1);
+    memmove(s->ptr + n, s->ptr, sizeof(char) * s->length);
+    s->length += n;
+    s->ptr[s->length] = 0;
 }
 
 char z_str_pop_char(Z_String *s)
@@ -161,23 +207,118 @@ char z_str_pop_char(Z_String *s)
 
 void z_str_replace(Z_String *s, Z_String_View target, Z_String_View replacement)
 {
-    Z_Heap_Auto heap = {0};
-    Z_String tmp = z_str_new(&heap, "");
+    z_str_replace_many(s, &target, &replacement, 1);
+}
 
-    size_t i = 0;
+// Leftmost occurrence at or after cursor of any target, ties go to the
+// earlier target. next caches where each target occurs next, every target
+// is searched for again only once the cursor has moved past it, so each
+// one scans the text a single time.
+size_t z__str_replace_next(Z_String_View text, const Z_String_View *targets, size_t count, size_t *next, size_t cursor, size_t *which)
+{
+    size_t best = SIZE_MAX;
 
-    while (i < s->length) {
-        if (z_sv_equal_n(z_sv_advance(z_sv(s), i), target, target.length)) {
-            z_str_append_str(&tmp, replacement);
-            i += target.length;
-        } else {
-            z_str_append_char(&tmp, s->ptr[i]);
-            i++;
+    for (size_t i = 0; i < count; i++) {
+        if (next[i] < cursor) {
+            ssize_t found = z_sv_find_index(z_sv_advance(text, cursor), targets[i]);
+            next[i] = found < 0 ? SIZE_MAX : cursor + (size_t)found;
+        }
+
+        if (next[i] < best) {
+            best = next[i];
+            *which = i;
         }
     }
 
-    z_str_clear(s);
-    z_str_append_format(s, "%s", tmp.ptr);
+    return best;
+}
+
+void z__str_replace_start(Z_String_View text, const Z_String_View *targets, size_t count, size_t *next)
+{
+    for (size_t i = 0; i < count; i++) {
+        ssize_t found = targets[i].length == 0 ? -1 : z_sv_find_index(text, targets[i]);
+        next[i] = found < 0 ? SIZE_MAX : (size_t)found;
+    }
+}
+
+bool z__str_overlaps(const Z_String *s, Z_String_View view)
+{
+    return view.ptr < s->ptr + s->capacity && s->ptr < view.ptr + view.length;
+}
+
+// Replaces every non overlapping occurrence of the targets, scanning left
+// to right. When no replacement is longer than its target the text is
+// compacted in place, otherwise the matches are counted first and the
+// result is written once into a buffer of its exact size.
+void z_str_replace_many(Z_String *s, const Z_String_View *targets, const Z_String_View *replacements, size_t count)
+{
+    if (s->length == 0 || count == 0) {
+        return;
+    }
+
+    // next match position of each target, on the stack for the common
+    // handful of targets so z_str_replace() never allocates for it
+    size_t stack_next[Z__REPLACE_STACK_TARGETS];
+    size_t *next = count <= Z__REPLACE_STACK_TARGETS ? stack_next : z_heap_malloc(s->heap, sizeof(size_t) * count);
+    Z_String_View text = { .ptr = s->ptr, .length = s->length };
+    size_t length = s->length;
+    size_t which = 0;
+    bool in_place = true;
+
+    for (size_t i = 0; i < count; i++) {
+        in_place = in_place && replacements[i].length <= targets[i].length
+            && !z__str_overlaps(s, targets[i]) && !z__str_overlaps(s, replacements[i]);
+    }
+
+    if (!in_place) {
+        size_t matches = 0;
+        z__str_replace_start(text, targets, count, next);
+
+        for (size_t at = z__str_replace_next(text, targets, count, next, 0, &which); at != SIZE_MAX;) {
+            length = length - targets[which].length + replacements[which].length;
+            matches++;
+            at = z__str_replace_next(text, targets, count, next, at + targets[which].length, &which);
+        }
+
+        if (matches == 0) {
+            if (next != stack_next) {
+                z_heap_free(s->heap, next);
+            }
+
+            return;
+        }
+    }
+
+    char *out = in_place ? s->ptr : z_heap_malloc(s->heap, length + 1);
+    size_t read = 0;
+    size_t write = 0;
+
+    z__str_replace_start(text, targets, count, next);
+
+    for (size_t at = z__str_replace_next(text, targets, count, next, 0, &which); at != SIZE_MAX;) {
+        memmove(out + write, text.ptr + read, at - read);
+        write += at - read;
+        memcpy(out + write, replacements[which].ptr, replacements[which].length);
+        write += replacements[which].length;
+        read = at + targets[which].length;
+        at = z__str_replace_next(text, targets, count, next, read, &which);
+    }
+
+    memmove(out + write, text.ptr + read, s->length - read);
+    write += s->length - read;
+
+    if (next != stack_next) {
+        z_heap_free(s->heap, next);
+    }
+
+    if (!in_place) {
+        z_heap_free(s->heap, s->ptr);
+        s->ptr = out;
+        s->capacity = length + 1;
+    }
+
+    s->length = write;
+    z_array_zero_terminate(s);
 }
 
 Z_Sv_Split_Iter z_sv_split_iter(Z_String_View s, Z_String_View delimeter)
@@ -212,6 +353,18 @@ bool z_sv_split_iter_next(Z_Sv_Split_Iter *iterator, Z_String_View *slice)
     return true;
 }
 
+// Views into s, nothing is copied. Prefer it to z_str_split when the tokens
+// don't outlive s.
+void z_sv_split(Z_String_View s, Z_String_View delimiter, Z_String_View_Array *out)
+{
+    Z_Sv_Split_Iter iter = z_sv_split_iter(s, delimiter);
+    Z_String_View curr;
+
+    while (z_sv_split_iter_next(&iter, &curr)) {
+        z_array_push(out, curr);
+    }
+}
+
 void z_str_split(Z_String_View s, Z_String_View delimiter, Z_String_Array *out)
 {
     Z_Sv_Split_Iter iter = z_sv_split_iter(s, delimiter);
@@ -303,7 +456,22 @@ int z_sv_compare(Z_String_View a, Z_String_View b)
 
 bool z_sv_equal(Z_String_View a, Z_String_View b)
 {
-    return z_sv_compare(a, b) == 0;
+    return a.length == b.length && memcmp(a.ptr, b.ptr, a.length) == 0;
+}
+
+size_t z_sv_hash(Z_String_View s)
+{
+    return z_hash_bytes(s.ptr, s.length);
+}
+
+size_t z_sv_ptr_hash(const void *s)
+{
+    return z_sv_hash(*(const Z_String_View *)s);
+}
+
+bool z_sv_ptr_equal(const void *a, const void *b)
+{
+    return z_sv_equal(*(const Z_String_View *)a, *(const Z_String_View *)b);
 }
 
 bool z_sv_naive_like(Z_String_View str, Z_String_View pattern)
@@ -413,25 +581,6 @@ bool z_sv_contain_char(Z_String_View s, char c)
     return memchr(s.ptr, c, s.length);
 }
 
-ssize_t z_sv_find_index(Z_String_View haystack, Z_String_View needle)
-{
-    if (needle.length == 0) {
-        return 0;
-    }
-
-    if (needle.length > haystack.length) {
-        return -1;
-    }
-
-    for (size_t i = 0; i < haystack.length - needle.length + 1; i++) {
-        if (memcmp(haystack.ptr + i, needle.ptr, needle.length) == 0) {
-            return (ssize_t)i;
-        }
-    }
-
-    return -1;
-}
-
 void z_str_trim(Z_String *s)
 {
     z_str_trim_right(s);
@@ -0,0 +1,224 @@
+#include <z_string_builder.h>
+#include <z_error.h>
+#include <stdio.h>
+#include <string.h>
+#include <internal/z_config.h>
+#include <internal/z_math.h>
+
+#define Z_SB_MIN_CAPACITY 32
+
+char *z__sb_alloc(Z_Heap *heap, size_t capacity);
+void z__sb_reserve(Z_String_Builder *sb, size_t front, size_t back);
+bool z__sb_overlaps(const Z_String_Builder *sb, Z_String_View view);
+size_t z__get_format_length(const char *format, va_list args);
+
+Z_String_Builder z_sb_new(Z_Heap *heap)
+{
+    return z_sb_new_with_capacity(heap, 0, 0);
+}
+
+Z_String_Builder z_sb_new_with_capacity(Z_Heap *heap, size_t front, size_t back)
+{
+    size_t capacity = front + back + 1;
+
+    Z_String_Builder sb = {
+        .heap = heap,
+        .ptr = z__sb_alloc(heap, capacity),
+        .start = front,
+        .length = 0,
+        .capacity = capacity,
+    };
+
+    sb.ptr[sb.start] = 0;
+
+    return sb;
+}
+
+char *z__sb_alloc(Z_Heap *heap, size_t capacity)
+{
+    char *ptr = z_heap_malloc(heap, capacity);
+
+    if (!ptr) {
+        z_die("z_string_builder: out of memory\n");
+    }
+
+    return ptr;
+}
+
+// Makes room for front more bytes before the text and back more after it,
+// terminator not included. A new buffer is at least twice the size needed
+// and the side that ran out gets all of the spare room, so a builder that
+// only ever grows one way does not waste space on the other.
+void z__sb_reserve(Z_String_Builder *sb, size_t front, size_t back)
+{
+    size_t tail = sb->capacity - sb->start - sb->length - 1;
+
+    if (sb->start >= front && tail >= back) {
+        return;
+    }
+
+    size_t needed = front + sb->length + back + 1;
+    size_t capacity = z__max_size_t(Z_SB_MIN_CAPACITY, needed * Z_BUFFER_GROWTH_FACTOR);
+    size_t spare = capacity - needed;
+    size_t start = front;
+
+    if (sb->start < front) {
+        start += tail < back ? spare / 2 : spare;
+    }
+
+    char *ptr = z__sb_alloc(sb->heap, capacity);
+    memcpy(ptr + start, sb->ptr + sb->start, sb->length + 1);
+    z_heap_free(sb->heap, sb->ptr);
+
+    sb->ptr = ptr;
+    sb->start = start;
+    sb->capacity = capacity;
+}
+
+bool z__sb_overlaps(const Z_String_Builder *sb, Z_String_View view)
+{
+    return view.ptr < sb->ptr + sb->capacity && sb->ptr < view.ptr + view.length;
+}
+
+// s may be a view of the builder itself, it is found again relative to the
+// text if the reserve moves the buffer
+void z_sb_prepend_str(Z_String_Builder *sb, Z_String_View s)
+{
+    bool overlaps = z__sb_overlaps(sb, s);
+    ptrdiff_t offset = overlaps ? s.ptr - (sb->ptr + sb->start) : 0;
+
+    z__sb_reserve(sb, s.length, 0);
+
+    if (overlaps) {
+        s.ptr = sb->ptr + sb->start + offset;
+    }
+
+    sb->start -= s.length;
+    sb->length += s.length;
+    memmove(sb->ptr + sb->start, s.ptr, s.length);
+}
+
+void z_sb_prepend_char(Z_String_Builder *sb, char c)
+{
+    z__sb_reserve(sb, 1, 0);
+    sb->ptr[--sb->start] = c;
+    sb->length++;
+}
+
+void z_sb_prepend_format(Z_String_Builder *sb, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    z_sb_prepend_format_va(sb, format, args);
+    va_end(args);
+}
+
+void z_sb_prepend_format_va(Z_String_Builder *sb, const char *format, va_list args)
+{
+    size_t format_length = z__get_format_length(format, args);
+    z__sb_reserve(sb, format_length, 0);
+
+    // vsnprintf terminates what it writes, over the first byte of the old text
+    char first = sb->ptr[sb->start];
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    vsnprintf(sb->ptr + sb->start - format_length, format_length + 1, format, args_copy);
+    va_end(args_copy);
+
+    sb->ptr[sb->start] = first;
+    sb->start -= format_length;
+    sb->length += format_length;
+}
+
+void z_sb_append_str(Z_String_Builder *sb, Z_String_View s)
+{
+    bool overlaps = z__sb_overlaps(sb, s);
+    ptrdiff_t offset = overlaps ? s.ptr - (sb->ptr + sb->start) : 0;
+
+    z__sb_reserve(sb, 0, s.length);
+
+    if (overlaps) {
+        s.ptr = sb->ptr + sb->start + offset;
+    }
+
+    char *end = sb->ptr + sb->start + sb->length;
+    memmove(end, s.ptr, s.length);
+    end[s.length] = 0;
+    sb->length += s.length;
+}
+
+void z_sb_append_char(Z_String_Builder *sb, char c)
+{
+    z__sb_reserve(sb, 0, 1);
+    char *end = sb->ptr + sb->start + sb->length;
+    end[0] = c;
+    end[1] = 0;
+    sb->length++;
+}
+
+void z_sb_append_format(Z_String_Builder *sb, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    z_sb_append_format_va(sb, format, args);
+    va_end(args);
+}
+
+void z_sb_append_format_va(Z_String_Builder *sb, const char *format, va_list args)
+{
+    size_t format_length = z__get_format_length(format, args);
+    z__sb_reserve(sb, 0, format_length);
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    vsnprintf(sb->ptr + sb->start + sb->length, format_length + 1, format, args_copy);
+    va_end(args_copy);
+
+    sb->length += format_length;
+}
+
+Z_String_View z_sb_view(const Z_String_Builder *sb)
+{
+    Z_String_View view = {
+        .ptr = sb->ptr + sb->start,
+        .length = sb->length,
+    };
+
+    return view;
+}
+
+size_t z_sb_length(const Z_String_Builder *sb)
+{
+    return sb->length;
+}
+
+// Keeps the buffer, and puts the empty text in its middle since the next
+// use may grow either way.
+void z_sb_clear(Z_String_Builder *sb)
+{
+    sb->start = (sb->capacity - 1) / 2;
+    sb->length = 0;
+    sb->ptr[sb->start] = 0;
+}
+
+// Moves the text to the front of the buffer and hands the buffer over, the
+// builder is left empty and has to be created again before reuse.
+Z_String z_sb_to_str(Z_String_Builder *sb)
+{
+    memmove(sb->ptr, sb->ptr + sb->start, sb->length + 1);
+
+    Z_String s = {
+        .heap = sb->heap,
+        .ptr = sb->ptr,
+        .length = sb->length,
+        .capacity = sb->capacity,
+    };
+
+    sb->ptr = NULL;
+    sb->start = 0;
+    sb->length = 0;
+    sb->capacity = 0;
+
+    return s;
+}